@@ -8,6 +8,8 @@ module ImageProcessing
     IMAGES_DIR = File.join(PROJECT_ROOT_DIR, "images")
     CONFIG_DIR = File.join(PROJECT_ROOT_DIR, "config")
     RESULTS_DIR = File.join(PROJECT_ROOT_DIR, "results")
+    # output rows ShrinkImage computes at once, bounding its memory use
+    SHRINK_STRIP_HEIGHT = 256
     
     attr_reader :host, :user, :password,
                 :remote_originals_dir, :local_originals_dir,
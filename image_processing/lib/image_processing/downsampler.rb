@@ -19,7 +19,7 @@ module ImageProcessing
       until @file_manager.originals_to_be_downsampled.empty?
         puts "Downsampled #{@file_manager.processed_files.count} of #{@file_manager.remote_originals.count} files..."
         unless @file_manager.originals_ready_to_be_downsampled.empty?
-          downsample_file(@file_manager.originals_ready_to_be_downsampled[0])
+          downsample_files(@file_manager.originals_ready_to_be_downsampled)
         else
           puts "No files ready to downsample yet, sleeping..."
           sleep 10
@@ -29,19 +29,35 @@ module ImageProcessing
       puts "All files have been downsampled!"
     end
     
-    def downsample_file(filename)
-      original   = File.join(@config.local_originals_dir,   filename)
-      downsample = File.join(@config.local_downsamples_dir, filename)
-      print "Downsampling #{filename}..."
-      `../itk/ShrinkImage '#{original}' '#{downsample}' #{@config.downsample_ratio}`
-      if $? == 0
-        puts "done."
-        print "Removing hi-res copy of #{filename}..."
-        rm "#{original}"
-        puts "done.\n\n"
-      else
-        @file_manager.add_error_file(filename)
+    # shrinks every file in one process, which prints a status line for each
+    def downsample_files(filenames)
+      list = File.join(@config.local_dataset_dir, "downsample_list.txt")
+      File.open(list, 'w') do |f|
+        filenames.each do |filename|
+          f.puts [File.join(@config.local_originals_dir,   filename),
+                  File.join(@config.local_downsamples_dir, filename)].join("\t")
+        end
+      end
+      
+      puts "Downsampling #{filenames.count} files..."
+      unreported = filenames.dup
+      `../itk/BatchShrinkImages #{@config.downsample_ratio} --list '#{list}' --stripHeight #{Config::SHRINK_STRIP_HEIGHT}`.each_line do |line|
+        status, original = line.chomp.split("\t")
+        filename = File.basename(original)
+        unreported.delete(filename)
+        if status == "failed"
+          @file_manager.add_error_file(filename)
+        else
+          puts "Downsampled #{filename}."
+          print "Removing hi-res copy of #{filename}..."
+          rm original
+          puts "done.\n\n"
+        end
       end
+      rm list
+      
+      # the process died before reaching these
+      unreported.each {|filename| @file_manager.add_error_file(filename) }
     end
   end
 end
@@ -11,10 +11,11 @@ module ImageProcessing
     def go
       check_local_dirs
       
-      originals_to_be_downsampled.each do |filename|
-        downsample_file(filename)
+      if originals_to_be_downsampled.empty?
+        puts "All files have already been downsampled!"
+      else
+        downsample_files
       end
-      puts "All files have been submitted!"
     end
     
   # private
@@ -24,13 +25,12 @@ module ImageProcessing
       end
     end
      
-    def downsample_file(filename)
-      original   = File.join(@config.local_originals_dir,   filename)
-      downsample = File.join(@config.local_downsamples_dir, filename)
-      executable = File.join(Config::PROJECT_ROOT_DIR, "pbs_scripts", ENV['HOST'], "shrink_image")
+    # a single job shrinks every original, skipping those already downsampled
+    def downsample_files
+      executable = File.join(Config::PROJECT_ROOT_DIR, "pbs_scripts", ENV['HOST'], "batch_shrink_images")
       
-      print "Submitting #{filename}..."
-      `echo '#{executable} #{original} #{downsample} #{@config.downsample_ratio}' | qsub -N #{filename}`
+      print "Submitting #{originals_to_be_downsampled.count} files..."
+      `echo '#{executable} #{@config.local_originals_dir} #{@config.local_downsamples_dir} #{@config.downsample_ratio} #{Config::SHRINK_STRIP_HEIGHT}' | qsub -N downsample_#{@config.downsample_ratio}`
       puts "done."
     end
   
@@ -9,23 +9,31 @@ module ImageProcessing
     end
     
     def go
-      until images_to_be_converted.empty?
-        convert_rgba(images_to_be_converted[0])
-        puts "Converted #{rgb_images.count} of #{rgba_images.count} images."
-      end
-      puts "All RGBA files have been converted!"
+      filenames = images_to_be_converted
+      convert_rgba(filenames) unless filenames.empty?
+      puts "Converted #{rgb_images.count} of #{rgba_images.count} images."
+      puts "All RGBA files have been converted!" if images_to_be_converted.empty?
     end
-        
-    def convert_rgba(filename)
-      print "Converting #{filename}..."
+    
+    # converts all the files in one process, several at a time
+    def convert_rgba(filenames)
+      list = File.join(@rgb_dir, ".rgba_list.txt")
+      File.open(list, 'w') do |f|
+        filenames.each do |filename|
+          f.puts [File.join(@rgba_dir, filename), File.join(@rgb_dir, filename)].join("\t")
+        end
+      end
+      
+      puts "Converting #{filenames.count} files..."
       command = [
-        File.join(Config::ITK_DIR, "ConvertRGBAToRGB"),
-        File.join(@rgba_dir, filename),
-        File.join(@rgb_dir, filename)
+        File.join(Config::ITK_DIR, "BatchProcessImages"),
+        "rgba",
+        "--list", list
       ].join(" ")
       
       # run command
       system command
+      File.delete(list)
       puts "done"
     end
     
@@ -14,7 +14,7 @@ namespace po = boost::program_options;
 po::variables_map parse_arguments(int argc, char *argv[]);
 
 template<typename ImageType>
-void apply_structure_tensor(const string& input, const string& output, const double sigma)
+void apply_structure_tensor(const string& input, const string& output, const double sigma, bool fused, bool allAxes, unsigned int threads)
 {
   cout << "Reading image..." << flush;
   typename ImageType::Pointer image = readImage< ImageType >(input);
@@ -23,6 +23,9 @@ void apply_structure_tensor(const string& input, const string& output, const dou
   typedef itk::StructureTensorImageFilter< ImageType > FilterType;
   typename FilterType::Pointer filter = FilterType::New();
   filter->SetSigma(sigma);
+  filter->SetFused(fused);
+  filter->SetSmoothAllAxes(allAxes);
+  if(threads) filter->SetNumberOfThreads(threads);
   filter->SetInput(image);
   
   cout << "Calculating structure tensor image..." << flush;
@@ -43,17 +46,20 @@ int main(int argc, char *argv[]) {
   unsigned int dim = vm["dimension"].as<unsigned int>();
   
   typedef float PixelType;
+  const bool fused = !vm["unfused"].as<bool>();
+  const bool allAxes = vm["allAxes"].as<bool>();
+  const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : 0;
   
   if(dim == 2)
   {
     typedef itk::Image< PixelType, 2 > ImageType;
-    apply_structure_tensor< ImageType >(vm["inputImage"].as<string>(), vm["outputImage"].as<string>(), vm["sigma"].as<double>() );
+    apply_structure_tensor< ImageType >(vm["inputImage"].as<string>(), vm["outputImage"].as<string>(), vm["sigma"].as<double>(), fused, allAxes, threads );
   }
   
   if(dim == 3)
   {
     typedef itk::Image< PixelType, 3 > ImageType;
-    apply_structure_tensor< ImageType >(vm["inputImage"].as<string>(), vm["outputImage"].as<string>(), vm["sigma"].as<double>() );
+    apply_structure_tensor< ImageType >(vm["inputImage"].as<string>(), vm["outputImage"].as<string>(), vm["sigma"].as<double>(), fused, allAxes, threads );
   }
   
   return EXIT_SUCCESS;
@@ -69,6 +75,9 @@ po::variables_map parse_arguments(int argc, char *argv[])
       ("outputImage", po::value<string>(), "result")
       ("dimension", po::value<unsigned int>()->default_value(3), "number of dimensions in the image")
       ("sigma", po::value<double>()->default_value(1.0), "standard deviation of the Gaussian smoothing of the tensor image")
+      ("unfused", po::bool_switch(), "build full-size gradient and tensor images with ITK filters, rather than a slab at a time, with a recursive Gaussian as before")
+      ("allAxes", po::bool_switch(), "smooth the tensors along every axis, rather than along x only; not with --unfused")
+      ("threads,t", po::value<unsigned int>(), "number of threads, defaulting to ITK's global default")
   ;
   
   po::positional_options_description p;
@@ -116,5 +125,11 @@ po::variables_map parse_arguments(int argc, char *argv[])
     exit(EXIT_FAILURE);
   }
   
+  if(vm["unfused"].as<bool>() && vm["allAxes"].as<bool>())
+  {
+    cerr << "--allAxes needs the fused filter, so can't be used with --unfused" << endl;
+    exit(EXIT_FAILURE);
+  }
+  
   return vm;
 }
@@ -0,0 +1,215 @@
+// Applies one of the single-image utilities to many images in one process,
+// several at a time, e.g.
+// BatchProcessImages rgba --inputDir=rgba --outputDir=rgb
+// BatchProcessImages operations --operations rotate flip --list=pairs.txt --threads=8
+// BatchProcessImages stats --inputDir=segmentations
+// See BatchProcessor.hpp for the list format and output.
+
+#include "boost/program_options.hpp"
+
+#include "itkImage.h"
+#include "itkRGBPixel.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkStatisticsImageFilter.h"
+
+#include "BatchProcessor.hpp"
+#include "ImageOperations.hpp"
+#include "IntensityMapping.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+
+typedef itk::Image< unsigned char, 2 > ScalarImageType;
+
+po::variables_map parse_arguments(int argc, char *argv[]);
+
+// as ConvertImage
+template <typename ImageType>
+struct Convert {
+  bool operator()(const string& input, const string& output)
+  {
+    BatchProcessor::Write< ImageType >( BatchProcessor::Read< ImageType >(input), output );
+    return true;
+  }
+};
+
+// as ConvertRGBAToRGB, RotateImage, FlipImage, CropImage, PadImage
+// and ShrinkImage, or any sequence of them, as ProcessImage
+struct ApplyOperations {
+  const vector< ImageOperations::Operation >& operations;
+  
+  ApplyOperations(const vector< ImageOperations::Operation >& o): operations(o) {}
+  
+  bool operator()(const string& input, const string& output)
+  {
+    using namespace ImageOperations;
+    ImageType::Pointer image;
+    if( !operations.empty() && operations[0].name == "rgba" )
+    {
+      image = ConvertRGBAToRGB( BatchProcessor::Read< RGBAImageType >(input), 1 );
+    }
+    else
+    {
+      image = BatchProcessor::Read< ImageType >(input);
+    }
+    
+    // images are already processed in parallel
+    image = Apply( image, operations, operations.empty() || operations[0].name != "rgba" ? 0 : 1, 1 );
+    BatchProcessor::Write< ImageType >( image, output );
+    return true;
+  }
+};
+
+// as RescaleIntensity and IntensifyImage, which first inverts
+struct Rescale {
+  bool invert;
+  unsigned int minimum, maximum;
+  
+  Rescale(bool i, unsigned int mi, unsigned int ma): invert(i), minimum(mi), maximum(ma) {}
+  
+  bool operator()(const string& input, const string& output)
+  {
+    ScalarImageType::Pointer image = BatchProcessor::Read< ScalarImageType >(input);
+    
+    // images are already processed in parallel
+    unsigned char low, high;
+    IntensityMapping::FindExtrema( image, low, high, 1 );
+    IntensityMapping::Mapping mapping( low, high );
+    if( invert ) mapping.Invert();
+    mapping.Rescale( minimum, maximum );
+    
+    BatchProcessor::Write< ScalarImageType >( IntensityMapping::Apply( image, mapping, 1 ), output );
+    return true;
+  }
+};
+
+// as ImageStats, printing a line of input, minimum, maximum, mean and sigma for each image
+struct Stats {
+  itk::SimpleFastMutexLock outputLock;
+  
+  bool operator()(const string& input, const string&)
+  {
+    typedef itk::StatisticsImageFilter< ScalarImageType > StatsType;
+    StatsType::Pointer stats = StatsType::New();
+    stats->SetInput( BatchProcessor::Read< ScalarImageType >(input) );
+    stats->SetNumberOfThreads( 1 );
+    stats->Update();
+    
+    outputLock.Lock();
+    cout << "stats\t" << input << "\t" << stats->GetMinimum() + 0 << "\t" << stats->GetMaximum() + 0
+         << "\t" << stats->GetMean() << "\t" << stats->GetSigma() << endl;
+    outputLock.Unlock();
+    return true;
+  }
+};
+
+int main( int argc, char * argv[] )
+{
+  po::variables_map vm = parse_arguments(argc, argv);
+  const string utility = vm["utility"].as<string>();
+  
+  vector< string > inputs, outputs;
+  BatchProcessor::GetImages(vm, inputs, outputs);
+  const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : 0;
+  const bool force = vm["force"].as<bool>();
+  
+  bool succeeded = true;
+  if( utility == "convert" )
+  {
+    if( vm["pixelType"].as<string>() == "rgb" )
+    {
+      Convert< itk::Image< itk::RGBPixel< unsigned char >, 2 > > convert;
+      succeeded = BatchProcessor::Process(convert, inputs, outputs, threads, force);
+    }
+    else
+    {
+      Convert< itk::Image< float, 2 > > convert;
+      succeeded = BatchProcessor::Process(convert, inputs, outputs, threads, force);
+    }
+  }
+  if( utility == "rgba" || utility == "flip" || utility == "rotate" || utility == "operations" )
+  {
+    vector< string > specifications(1, utility);
+    if( utility == "operations" ) specifications = vm["operations"].as< vector< string > >();
+    const vector< ImageOperations::Operation > operations = ImageOperations::Parse(specifications);
+    ApplyOperations applyOperations(operations);
+    succeeded = BatchProcessor::Process(applyOperations, inputs, outputs, threads, force);
+  }
+  if( utility == "rescale" )
+  {
+    Rescale rescale(false, 0, vm["max"].as<unsigned int>());
+    succeeded = BatchProcessor::Process(rescale, inputs, outputs, threads, force);
+  }
+  if( utility == "intensify" )
+  {
+    Rescale rescale(!vm["no-invert"].as<bool>(), vm["min"].as<unsigned int>(), vm["max"].as<unsigned int>());
+    succeeded = BatchProcessor::Process(rescale, inputs, outputs, threads, force);
+  }
+  if( utility == "stats" )
+  {
+    Stats stats;
+    succeeded = BatchProcessor::Process(stats, inputs, vector< string >(inputs.size()), threads, force);
+  }
+  
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+po::variables_map parse_arguments(int argc, char *argv[])
+{
+  // Declare the supported options.
+  po::options_description opts("Options");
+  opts.add_options()
+      ("help,h", "produce help message")
+      ("utility", po::value<string>(), "convert, rgba, flip, rotate, operations, rescale, intensify or stats")
+      ("pixelType", po::value<string>()->default_value("rgb"), "convert: either 'rgb' or 'float'")
+      ("operations", po::value< vector< string > >()->multitoken(), "operations: the sequence to apply, as ProcessImage")
+      ("no-invert", po::bool_switch(), "intensify: do not invert intensities")
+      ("min", po::value<unsigned int>()->default_value(0), "intensify: minimum output intensity")
+      ("max", po::value<unsigned int>()->default_value(255), "rescale, intensify: maximum output intensity")
+  ;
+  opts.add( BatchProcessor::Options() );
+  
+  po::positional_options_description p;
+  p.add("utility", 1);
+  
+  // parse command line
+  po::variables_map vm;
+	try
+	{
+  po::store(po::command_line_parser(argc, argv)
+            .options(opts)
+            .positional(p)
+            .run(),
+            vm);
+	}
+	catch (std::exception& e)
+	{
+	  cerr << "caught command-line parsing error" << endl;
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  po::notify(vm);
+  
+  const string utilities[] = { "convert", "rgba", "flip", "rotate", "operations", "rescale", "intensify", "stats" };
+  const string *utilitiesEnd = utilities + sizeof(utilities) / sizeof(utilities[0]);
+  
+  // if help is specified, or positional args aren't present,
+  // or not exactly one of a list or pair of directories
+  if(    vm.count("help")
+     || !vm.count("utility")
+     || find(utilities, utilitiesEnd, vm["utility"].as<string>()) == utilitiesEnd
+     || !BatchProcessor::OptionsAreValid(vm, vm["utility"].as<string>() != "stats")
+     || ( vm["utility"].as<string>() == "operations" && !vm.count("operations") )
+     || ( vm["pixelType"].as<string>() != "rgb" && vm["pixelType"].as<string>() != "float" )
+    )
+  {
+    cerr << "Usage: "
+      << argv[0] << " [--utility=]rotate (--list=pairs.txt | --inputDir=originals --outputDir=rotated) [Options]"
+      << endl << endl;
+    cerr << opts << endl;
+    cerr << "Operations:" << endl << ImageOperations::Usage();
+    exit(EXIT_FAILURE);
+  }
+  
+  return vm;
+}
@@ -0,0 +1,142 @@
+// Smoothes and downsamples many RGB images in one process, as ShrinkImage does,
+// so that one image's reading or writing can overlap another's smoothing.
+// Originals that can't be streamed, such as BMPs, are read whole, so by default
+// one image is shrunk at a time, using all the threads; --memory lets as many
+// run at once as fit in the given budget, up to --threads.
+// Outputs newer than their inputs are skipped, so interrupted runs can be restarted;
+// see BatchProcessor.hpp for the list format and output.
+
+#include "boost/program_options.hpp"
+
+#include "itkMultiThreader.h"
+
+#include "Shrinker.hpp"
+#include "BatchProcessor.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+po::variables_map parse_arguments(int argc, char *argv[]);
+
+struct Shrink {
+  unsigned int factor, stripHeight, numberOfThreads;
+  bool fused;
+  
+  Shrink(unsigned int f, unsigned int s, bool u): factor(f), stripHeight(s), numberOfThreads(0), fused(u) {}
+  
+  // shrinks the image into a partial file, moved into place once complete
+  bool operator()(const string& input, const string& output)
+  {
+    const fs::path partialPath = BatchProcessor::PartialPath(output);
+
+    try {
+      Shrinker::ShrinkFile( input, partialPath.string(), factor, stripHeight, fused, numberOfThreads );
+      fs::rename( partialPath, output );
+    }
+    catch( ... ) {
+      boost::system::error_code error;
+      fs::remove( partialPath, error );
+      throw;
+    }
+
+    return true;
+  }
+};
+
+// images to shrink at once: one by default, or as many as fit in the memory budget
+unsigned int concurrency(const po::variables_map& vm, const vector< string >& inputs, const Shrink& shrink)
+{
+  const unsigned int maximum = vm.count("threads") ? vm["threads"].as<unsigned int>() : itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  if( !vm.count("memory") ) return vm.count("threads") ? maximum : 1;
+
+  // budget for the largest image, reading just the headers
+  double largest = 0;
+  for(unsigned int i=0; i<inputs.size(); ++i)
+  {
+    try {
+      largest = max( largest, Shrinker::EstimateMemory(inputs[i], shrink.factor, shrink.stripHeight) );
+    }
+    catch( itk::ExceptionObject & ) {
+      // reported when the image itself fails
+    }
+  }
+  const double budget = vm["memory"].as<double>() * 1e9;
+  const unsigned int fit = largest > 0 ? static_cast< unsigned int >( budget / largest ) : maximum;
+  return max( 1u, min( maximum, fit ) );
+}
+
+int main( int argc, char * argv[] )
+{
+  po::variables_map vm = parse_arguments(argc, argv);
+
+  vector< string > inputs, outputs;
+  BatchProcessor::GetImages(vm, inputs, outputs);
+
+  Shrink shrink( vm["downsampleRatio"].as<unsigned int>(), vm["stripHeight"].as<unsigned int>(), vm["fused"].as<bool>() );
+  const unsigned int images = concurrency(vm, inputs, shrink);
+
+  // share the threads between the images being shrunk at once
+  const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  shrink.numberOfThreads = max( 1u, threads / images );
+  cerr << "Shrinking " << images << " image" << ( images == 1 ? "" : "s" ) << " at a time, with "
+       << shrink.numberOfThreads << " thread" << ( shrink.numberOfThreads == 1 ? "" : "s" ) << " each" << endl;
+
+  const bool succeeded = BatchProcessor::Process(shrink, inputs, outputs, images, vm["force"].as<bool>());
+
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+po::variables_map parse_arguments(int argc, char *argv[])
+{
+  // Declare the supported options.
+  po::options_description opts("Options");
+  opts.add_options()
+      ("help,h", "produce help message")
+      ("downsampleRatio", po::value<unsigned int>(), "downsample ratio, also the Gaussian's sigma in input pixels")
+      ("stripHeight", po::value<unsigned int>()->default_value(256), "number of output rows to compute at once, 0 for the whole image")
+      ("fused", po::bool_switch(), "smooth at the output samples only, with a truncated Gaussian rather than the recursive filters, as ShrinkImage --fused")
+      ("memory", po::value<double>(), "gigabytes to budget for images shrunk at once; without it, or --threads, one is shrunk at a time")
+  ;
+  opts.add( BatchProcessor::Options() );
+
+  po::positional_options_description p;
+  p.add("downsampleRatio", 1);
+
+  // parse command line
+  po::variables_map vm;
+	try
+	{
+  po::store(po::command_line_parser(argc, argv)
+            .options(opts)
+            .positional(p)
+            .run(),
+            vm);
+	}
+	catch (std::exception& e)
+	{
+	  cerr << "caught command-line parsing error" << endl;
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  po::notify(vm);
+
+  // if help is specified, or positional args aren't present,
+  // or not exactly one of a list or pair of directories
+  if(    vm.count("help")
+     || !vm.count("downsampleRatio")
+     || vm["downsampleRatio"].as<unsigned int>() == 0
+     || ( vm.count("threads") && vm["threads"].as<unsigned int>() == 0 )
+     || ( vm.count("memory") && vm["memory"].as<double>() <= 0 )
+     || !BatchProcessor::OptionsAreValid(vm)
+    )
+  {
+    cerr << "Usage: "
+      << argv[0] << " [--downsampleRatio=]8 (--list=pairs.txt | --inputDir=originals --outputDir=downsamples_8) [Options]"
+      << endl << endl;
+    cerr << opts << "\n";
+    exit(EXIT_FAILURE);
+  }
+
+  return vm;
+}
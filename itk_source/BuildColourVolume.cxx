@@ -38,6 +38,8 @@ int main(int argc, char *argv[]) {
   bool HiRes = !vm["no-HiRes"].as<bool>();
   string roi = vm["roi"].as<string>();
   string hiResName = vm["hiResName"].as<string>();
+  string extension = vm["extension"].as<string>();
+  int compressionLevel = vm["compressionLevel"].as<int>();
   
   // get file names
   vector< string > basenames = vm.count("slice") ? vector<string>( 1, vm["slice"].as<string>() ) : getBasenames(Dirs::ImageList());
@@ -85,7 +87,7 @@ int main(int argc, char *argv[]) {
     StackTransforms::Translate(*LoResStack, translation);
     // generate and save images
     LoResStack->updateVolumes();
-    writeImage< StackType::VolumeType >( LoResStack->GetVolume(), Dirs::ColourDir() + "LoRes.mha");
+    writeImage< StackType::VolumeType >( LoResStack->GetVolume(), Dirs::ColourDir() + "LoRes." + extension, compressionLevel);
     cout << "done." << endl;
   }
   
@@ -101,7 +103,7 @@ int main(int argc, char *argv[]) {
       StackTransforms::Translate(*HiResStack, translation);
       // generate and save images
       HiResStack->updateVolumes();
-      writeImage< StackType::VolumeType >( HiResStack->GetVolume(), dir + hiResName);
+      writeImage< StackType::VolumeType >( HiResStack->GetVolume(), dir + hiResName, compressionLevel);
       
     }
     else // process all three transform optimisations
@@ -119,7 +121,7 @@ int main(int argc, char *argv[]) {
         StackTransforms::Translate(*HiResStack, translation);
         // generate and save images
         HiResStack->updateVolumes();
-        writeImage< StackType::VolumeType >( HiResStack->GetVolume(), Dirs::ColourDir() + *it + ".mha");
+        writeImage< StackType::VolumeType >( HiResStack->GetVolume(), Dirs::ColourDir() + *it + "." + extension, compressionLevel);
       }
     }
     cout << "done." << endl;
@@ -142,6 +144,8 @@ po::variables_map parse_arguments(int argc, char *argv[])
       ("hiResTransformsDir", po::value<string>(), "directory containing HiRes transform files, relative to ResultsDir")
       ("blockDir", po::value<string>(), "directory containing LoRes originals")
       ("hiResName", po::value<string>()->default_value("HiRes.mha"), "name of the HiRes output file")
+      ("extension", po::value<string>()->default_value("mha"), "extension of the volumes written to the colour directory, e.g. tvol for tiled volumes")
+      ("compressionLevel", po::value<int>()->default_value(-1), "zlib compression level of the volumes, 0 for none, 1 fastest to 9 smallest, -1 for zlib's default")
       ("defaultPixelValue", po::value<unsigned int>()->default_value(255), "value applied to pixels outside the moving image")
 
       // three different ways of not specifying value for flag
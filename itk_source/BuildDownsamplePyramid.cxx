@@ -0,0 +1,144 @@
+// Smoothes and downsamples an RGB image to several ratios, reading it only once.
+// Each level is computed from the largest smaller level whose ratio divides its own,
+// smoothing by just enough to reach a total sigma of the level's ratio,
+// and is written to outputDir/downsamples_<ratio>/<input file name>.
+// Sources are the 8-bit, decimated levels themselves, so cascaded levels only
+// approximate smoothing the original directly, to within their rounding and the
+// aliasing of each step.
+
+#include <cmath>
+#include <map>
+#include <boost/lexical_cast.hpp>
+#include "boost/program_options.hpp"
+#include "boost/filesystem.hpp"
+
+#include "itkRGBPixel.h"
+#include "itkGaussianDownsampleImageFilter.h"
+
+#include "IOHelpers.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+typedef itk::RGBPixel< unsigned char > PixelType;
+typedef itk::Image< PixelType, 2 > ImageType;
+
+po::variables_map parse_arguments(int argc, char *argv[]);
+
+int main( int argc, char * argv[] )
+{
+  po::variables_map vm = parse_arguments(argc, argv);
+  const string inputFile = vm["inputFile"].as<string>();
+  const string outputDir = vm["outputDir"].as<string>();
+
+  // ascending, without duplicates
+  vector< unsigned int > ratios = vm["ratios"].as< vector< unsigned int > >();
+  sort(ratios.begin(), ratios.end());
+  ratios.erase(unique(ratios.begin(), ratios.end()), ratios.end());
+
+  // levels by ratio, starting with the unsmoothed original
+  map< unsigned int, ImageType::Pointer > levels;
+  levels[1] = readImage< ImageType >( inputFile );
+
+  for(unsigned int i=0; i<ratios.size(); ++i)
+  {
+    const unsigned int ratio = ratios[i];
+    if( ratio == 1 ) continue;
+
+    // the coarsest level already built that lies on this level's grid
+    unsigned int source = 1;
+    for(map< unsigned int, ImageType::Pointer >::const_iterator it=levels.begin(); it!=levels.end(); ++it)
+    {
+      if( ratio % it->first == 0 ) source = it->first;
+    }
+
+    // Gaussians compose by adding variances, so smooth by the remaining sigma,
+    // measured in the source level's pixels. The original counts as unsmoothed.
+    const double sourceSigma = source == 1 ? 0 : source;
+    const double sigma = sqrt( double(ratio) * ratio - sourceSigma * sourceSigma ) / source;
+
+    typedef itk::GaussianDownsampleImageFilter< ImageType > DownsamplerType;
+    DownsamplerType::Pointer downsampler = DownsamplerType::New();
+    downsampler->SetInput( levels[source] );
+    downsampler->SetShrinkFactor( ratio / source );
+    downsampler->SetSigma( sigma );
+
+    try {
+      downsampler->Update();
+    }
+    catch( itk::ExceptionObject & excep ) {
+      cerr << "Exception caught!" << endl;
+      cerr << excep << endl;
+      exit(EXIT_FAILURE);
+    }
+
+    ImageType::Pointer level = downsampler->GetOutput();
+    level->DisconnectPipeline();
+    levels[ratio] = level;
+
+    const string levelDir = outputDir + "/downsamples_" + boost::lexical_cast<string>(ratio);
+    fs::create_directories(levelDir);
+    writeImage< ImageType >( level, levelDir + "/" + fs::path(inputFile).filename().string() );
+  }
+
+  return EXIT_SUCCESS;
+}
+
+po::variables_map parse_arguments(int argc, char *argv[])
+{
+  // Declare the supported options.
+  po::options_description opts("Options");
+  opts.add_options()
+      ("help,h", "produce help message")
+      ("inputFile", po::value<string>(), "original image")
+      ("outputDir", po::value<string>(), "directory containing the downsamples_<ratio> directories, e.g. images/Rat24/HiRes")
+      ("ratios", po::value< vector< unsigned int > >()->multitoken(), "downsample ratios")
+  ;
+
+  po::positional_options_description p;
+  p.add("inputFile", 1)
+   .add("outputDir", 1)
+   .add("ratios", -1);
+
+  // parse command line
+  po::variables_map vm;
+	try
+	{
+  po::store(po::command_line_parser(argc, argv)
+            .options(opts)
+            .positional(p)
+            .run(),
+            vm);
+	}
+	catch (std::exception& e)
+	{
+	  cerr << "caught command-line parsing error" << endl;
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  po::notify(vm);
+
+  // if help is specified, or positional args aren't present
+  if(    vm.count("help")
+     || !vm.count("inputFile")
+     || !vm.count("outputDir")
+     || !vm.count("ratios")
+    )
+  {
+    cerr << "Usage: "
+      << argv[0] << " [--inputFile=]original.bmp [--outputDir=]images/Rat24/HiRes [--ratios=]8 16 32"
+      << endl << endl;
+    cerr << opts << "\n";
+    exit(EXIT_FAILURE);
+  }
+
+  const vector< unsigned int >& ratios = vm["ratios"].as< vector< unsigned int > >();
+  if( find(ratios.begin(), ratios.end(), 0u) != ratios.end() )
+  {
+    cerr << "Downsample ratios must be positive." << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  return vm;
+}
@@ -5,20 +5,114 @@
 #include "itkImageSeriesReader.h"
 #include "itkNumericSeriesFileNames.h"
 #include "itkChangeInformationImageFilter.h"
+#include "itkImageIOFactory.h"
+#include "itkSimpleFastMutexLock.h"
 
 #include "IOHelpers.hpp"
+#include "ParallelFor.hpp"
 #include "Parameters.hpp"
 
 namespace po = boost::program_options;
 po::variables_map parse_arguments(int argc, char *argv[]);
 
+typedef itk::RGBPixel< unsigned char > PixelType;
+typedef itk::Image< PixelType, 3 > ImageType;
+typedef itk::Image< PixelType, 2 > SliceType;
+
+ImageType::Pointer buildVolumeInParallel(const vector< string >& fileNames, double zSpacing, unsigned int threads);
+
+// Reads each slice straight into its z-plane of a volume allocated up front.
+// Slices that are missing, unreadable or of the wrong size are reported and left black.
+struct ReadSlices {
+  const vector< string >& fileNames;
+  ImageType *volume;
+  vector< bool > failed;
+  itk::SimpleFastMutexLock outputLock;
+  
+  ReadSlices(const vector< string >& f, ImageType *v):
+  fileNames(f), volume(v), failed(f.size(), false) {}
+  
+  void operator()(unsigned int i)
+  {
+    const string error = readSlice(fileNames[i], plane(i));
+    if( !error.empty() )
+    {
+      outputLock.Lock();
+      failed[i] = true;
+      cerr << "Slice " << fileNames[i] << " " << error << ", leaving it black." << endl;
+      outputLock.Unlock();
+    }
+  }
+  
+  PixelType * plane(unsigned int i)
+  {
+    return volume->GetBufferPointer() + i * planeSize()[0] * planeSize()[1];
+  }
+  
+  SliceType::SizeType planeSize() const
+  {
+    SliceType::SizeType size = {{ volume->GetLargestPossibleRegion().GetSize()[0],
+                                  volume->GetLargestPossibleRegion().GetSize()[1] }};
+    return size;
+  }
+  
+  // returns why the slice couldn't be read, or nothing if it was
+  string readSlice(const string& fileName, PixelType *out)
+  {
+    if( !fileExists(fileName) ) return "is missing";
+    
+    try {
+      itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO( fileName.c_str(), itk::ImageIOFactory::ReadMode );
+      if( !imageIO ) return "is in an unknown format";
+      imageIO->SetFileName( fileName );
+      imageIO->ReadImageInformation();
+      
+      const SliceType::SizeType size = planeSize();
+      if( imageIO->GetNumberOfDimensions() < 2 || imageIO->GetDimensions(0) != size[0] || imageIO->GetDimensions(1) != size[1]
+       || ( imageIO->GetNumberOfDimensions() > 2 && imageIO->GetDimensions(2) != 1 ) )
+      {
+        stringstream error;
+        error << "is " << imageIO->GetDimensions(0) << "x" << imageIO->GetDimensions(1)
+              << ", not " << size[0] << "x" << size[1];
+        return error.str();
+      }
+      
+      if( imageIO->GetComponentType() == itk::ImageIOBase::UCHAR && imageIO->GetNumberOfComponents() == 3 )
+      {
+        // decode straight into the plane
+        itk::ImageIORegion ioRegion( imageIO->GetNumberOfDimensions() );
+        for(unsigned int d=0; d<imageIO->GetNumberOfDimensions(); ++d)
+        {
+          ioRegion.SetIndex(d, 0);
+          ioRegion.SetSize(d, imageIO->GetDimensions(d));
+        }
+        imageIO->SetIORegion( ioRegion );
+        imageIO->Read( out );
+      }
+      else
+      {
+        // let the reader convert other pixel types
+        typedef itk::ImageFileReader< SliceType > ReaderType;
+        ReaderType::Pointer reader = ReaderType::New();
+        reader->SetFileName( fileName );
+        reader->Update();
+        const PixelType *in = reader->GetOutput()->GetBufferPointer();
+        copy(in, in + size[0] * size[1], out);
+      }
+    }
+    catch( itk::ExceptionObject & err ) {
+      return string("couldn't be read: ") + err.GetDescription();
+    }
+    
+    return "";
+  }
+};
+
 int main( int argc, char ** argv )
 {
   // Parse command line arguments
   po::variables_map vm = parse_arguments(argc, argv);
   
-  typedef itk::RGBPixel< unsigned char > PixelType;
-  typedef itk::Image< PixelType, 3 > ImageType;
   typedef itk::ImageSeriesReader< ImageType > SeriesReaderType;
   typedef itk::NumericSeriesFileNames NameGeneratorType;
   
@@ -29,6 +123,17 @@ int main( int argc, char ** argv )
   nameGenerator->SetEndIndex( vm["numberOfSlices"].as<unsigned int>() );
   nameGenerator->SetIncrementIndex( 1 );
   nameGenerator->SetSeriesFormat( vm["inputSeriesFormat"].as<string>() );
+  
+  if( vm["parallel"].as<bool>() )
+  {
+    const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : 0;
+    ImageType::Pointer volume = buildVolumeInParallel( nameGenerator->GetFileNames(), vm["zSpacing"].as<double>(), threads );
+    cerr << "Writing volume..." << flush;
+    writeImage<ImageType>(volume, vm["outputFile"].as<string>() );
+    cerr << "done." << endl;
+    return EXIT_SUCCESS;
+  }
+  
   seriesReader->SetFileNames( nameGenerator->GetFileNames() );
   cerr << "Reading images..." << flush;
   seriesReader->Update();
@@ -52,6 +157,56 @@ int main( int argc, char ** argv )
   return EXIT_SUCCESS;
 }
 
+// sizes the volume from the first slice that exists, then reads all the slices in parallel
+ImageType::Pointer buildVolumeInParallel(const vector< string >& fileNames, double zSpacing, unsigned int threads)
+{
+  unsigned int first = 0;
+  while( first < fileNames.size() && !fileExists(fileNames[first]) ) ++first;
+  if( first == fileNames.size() )
+  {
+    cerr << "None of the slices exist." << endl;
+    exit(EXIT_FAILURE);
+  }
+  
+  // also registers the image IO factories before any threads need them
+  SliceType::Pointer firstSlice = readImageInformation< SliceType >( fileNames[first] );
+  
+  ImageType::RegionType region;
+  ImageType::SpacingType spacing;
+  ImageType::PointType origin;
+  ImageType::DirectionType direction;
+  direction.SetIdentity();
+  for(unsigned int d=0; d<2; ++d)
+  {
+    region.SetIndex(d, 0);
+    region.SetSize(d, firstSlice->GetLargestPossibleRegion().GetSize()[d]);
+    spacing[d] = firstSlice->GetSpacing()[d];
+    origin[d] = firstSlice->GetOrigin()[d];
+    for(unsigned int e=0; e<2; ++e) direction[d][e] = firstSlice->GetDirection()[d][e];
+  }
+  region.SetIndex(2, 0);
+  region.SetSize(2, fileNames.size());
+  spacing[2] = zSpacing;
+  origin[2] = 0;
+  
+  ImageType::Pointer volume = ImageType::New();
+  volume->SetRegions(region);
+  volume->SetSpacing(spacing);
+  volume->SetOrigin(origin);
+  volume->SetDirection(direction);
+  volume->Allocate();
+  volume->FillBuffer( PixelType(static_cast< unsigned char >(0)) );
+  
+  cerr << "Reading images..." << endl;
+  ReadSlices readSlices(fileNames, volume);
+  parallelFor(fileNames.size(), readSlices, threads);
+  
+  const unsigned int failed = count(readSlices.failed.begin(), readSlices.failed.end(), true);
+  if( failed ) cerr << failed << " of " << fileNames.size() << " slices are black." << endl;
+  
+  return volume;
+}
+
 po::variables_map parse_arguments(int argc, char *argv[])
 {
   // Declare the supported options.
@@ -62,6 +217,8 @@ po::variables_map parse_arguments(int argc, char *argv[])
       ("inputSeriesFormat", po::value<string>()->default_value("HiRes_%03d.mha"), "format of image series file names")
       ("outputFile", po::value<string>()->default_value("HiRes.mha"), "name of output volume")
       ("zSpacing", po::value<double>()->default_value(10.0), "spacing in microns between slices")
+      ("parallel", po::bool_switch(), "read the slices in parallel straight into the volume, leaving missing or mis-sized slices black rather than aborting")
+      ("threads", po::value<unsigned int>(), "number of slices to read at once with --parallel, defaulting to ITK's global default number of threads")
   ;
   
   po::positional_options_description p;
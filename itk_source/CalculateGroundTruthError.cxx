@@ -8,12 +8,11 @@
 #include "itkTransformFileWriter.h"
 #include "itkTransformFactory.h"
 #include "itkIdentityTransform.h"
-#include "itkMatrixOffsetTransformBase.h"
 #include "itkImage.h"
-#include "itkImageRegionIterator.h"
 #include "itkImageFileReader.h"
 
 #include "IOHelpers.hpp"
+#include "GroundTruthError.hpp"
 
 // define pi
 const double pi = boost::math::constants::pi<double>();
@@ -22,6 +21,7 @@ using namespace std;
 namespace po = boost::program_options;
 
 po::variables_map parse_arguments(int argc, char *argv[]);
+GroundTruthError::TransformType::Pointer readCheckedTransform(string path);
 
 int main( int argc, char * argv[] )
 {
@@ -31,69 +31,51 @@ int main( int argc, char * argv[] )
 	// Some transforms might not be registered
   // with the factory so we add them manually
   itk::TransformFactoryBase::RegisterDefaultTransforms();
-  typedef itk::Transform< double, 2, 2 > TransformType;
+  typedef GroundTruthError::TransformType TransformType;
   
-  // read transforms
-  itk::TransformBase::Pointer bpTransform1 = readTransform(vm["transform1"].as<string>());
-  TransformType::Pointer transform1 = dynamic_cast<TransformType*>( bpTransform1.GetPointer() );
-  assert( transform1 != 0 );
-  
-  TransformType::Pointer transform2;
-  // use either transform2, or identity if none is specified
-  if(vm.count("transform2"))
-  {
-    itk::TransformBase::Pointer bpTransform2 = readTransform(vm["transform2"].as<string>());
-    transform2 = dynamic_cast<TransformType*>( bpTransform2.GetPointer() );
-    assert( transform2 != 0 );
-  }
-  else
-  {
-    transform2 = itk::IdentityTransform< double, 2 >::New();
-  }
-  
-  // calculate the mean Euclidian distance of each non-zero pixel
-  // after being transformed by the two transforms
-  double meanDistance = 0;
-  unsigned int countedPixels = 0, uncountedPixels = 0;
-  
-  typedef unsigned char PixelType;
-  typedef itk::Image< PixelType, 2 > ImageType;
-  typedef itk::ImageRegionConstIterator< ImageType > ConstIteratorType;
-  typedef itk::Point< double, 2 > PointType;
+  // statistics options
+  vector< double > percentiles;
+  if(vm.count("percentiles")) percentiles = vm["percentiles"].as< vector< double > >();
+  const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : 0;
   
+  // compact the non-zero pixels of the mask, which are counted
+  // in the mean Euclidian distance of each pixel after being
+  // transformed by the two transforms
+  typedef GroundTruthError::MaskType ImageType;
   ImageType::Pointer mask = readImage< ImageType >(vm["mask"].as<string>());
-  ImageType::RegionType inputRegion = mask->GetLargestPossibleRegion();
-  ConstIteratorType it(mask, inputRegion);
-  it.GoToBegin();
+  GroundTruthError::MaskPoints points(mask);
+  
+  // if transform1 is a directory, evaluate every transform in it
+  // against its namesake in transform2, otherwise just the one
+  const string transform1Path = vm["transform1"].as<string>();
+  const bool directoryMode = is_directory(transform1Path);
+  vector< string > basenames;
+  if(directoryMode) basenames = directoryContents(transform1Path);
+  else              basenames.push_back("");
   
-  while( !it.IsAtEnd() )
+  for(unsigned int i=0; i<basenames.size(); ++i)
   {
-    // if the pixel has a non-zero value,
-    // include it in the calculation of the mean distance
-    if(it.Get())
+    // read transforms
+    TransformType::Pointer transform1 = readCheckedTransform( directoryMode ? (path(transform1Path) / basenames[i]).string() : transform1Path );
+    
+    TransformType::Pointer transform2;
+    // use either transform2, or identity if none is specified
+    if(vm.count("transform2"))
     {
-      // calculate original physical position of pixel
-      ImageType::IndexType index = it.GetIndex();
-      PointType physicalPosition;
-      mask->TransformIndexToPhysicalPoint(index, physicalPosition);
-      
-      // add Euclidian distance to total
-      PointType position1 = transform1->GetInverseTransform()->TransformPoint(physicalPosition);
-      PointType position2 = transform2->GetInverseTransform()->TransformPoint(physicalPosition);
-      meanDistance += position1.EuclideanDistanceTo(position2);
-      
-      ++countedPixels;
+      const string transform2Path = vm["transform2"].as<string>();
+      transform2 = readCheckedTransform( directoryMode ? (path(transform2Path) / basenames[i]).string() : transform2Path );
     }
     else
     {
-      ++uncountedPixels;
+      transform2 = itk::IdentityTransform< double, 2 >::New();
     }
-    ++it;
+    
+    GroundTruthError::Statistics statistics = GroundTruthError::AbsoluteError(points, transform1, transform2, percentiles, threads);
+    
+    if(directoryMode) cout << basenames[i] << " ";
+    GroundTruthError::PrintStatistics(cout, statistics, vm.count("percentiles"));
   }
   
-  meanDistance /= countedPixels;
-  
-  cout << meanDistance << endl;
   return EXIT_SUCCESS;
 }
 
@@ -104,8 +86,10 @@ po::variables_map parse_arguments(int argc, char *argv[])
   opts.add_options()
       ("help,h", "produce help message")
       ("mask", po::value<string>(), "each non-zero pixel is counted in mean displacement")
-      ("transform1", po::value<string>(), "first transform")
-      ("transform2", po::value<string>(), "second transform")
+      ("transform1", po::value<string>(), "first transform, or directory of transforms")
+      ("transform2", po::value<string>(), "second transform, or directory of transforms")
+      ("percentiles", po::value< vector< double > >()->multitoken(), "also print the maximum and these percentiles of the distances")
+      ("threads", po::value<unsigned int>(), "number of threads, defaulting to ITK's global default")
   ;
   
   po::positional_options_description p;
@@ -142,6 +126,7 @@ po::variables_map parse_arguments(int argc, char *argv[])
     cerr << "Usage: "
       << argv[0] << " [--mask=]sliceMask.mha"
       << " [--transform1=]noisy/0001 [[--transform2=]perfect/0001]"
+      << " [--percentiles 50 90 99]"
       << endl << endl;
     cerr << opts << "\n";
     exit(EXIT_FAILURE);
@@ -149,3 +134,11 @@ po::variables_map parse_arguments(int argc, char *argv[])
   
   return vm;
 }
+
+GroundTruthError::TransformType::Pointer readCheckedTransform(string path)
+{
+  itk::TransformBase::Pointer bpTransform = readTransform(path);
+  GroundTruthError::TransformType::Pointer transform = dynamic_cast<GroundTruthError::TransformType*>( bpTransform.GetPointer() );
+  assert( transform != 0 );
+  return transform;
+}
@@ -8,12 +8,11 @@
 #include "itkTransformFileWriter.h"
 #include "itkTransformFactory.h"
 #include "itkIdentityTransform.h"
-#include "itkMatrixOffsetTransformBase.h"
 #include "itkImage.h"
-#include "itkImageRegionIterator.h"
 #include "itkImageFileReader.h"
 
 #include "IOHelpers.hpp"
+#include "GroundTruthError.hpp"
 
 // define pi
 const double pi = boost::math::constants::pi<double>();
@@ -23,7 +22,7 @@ namespace po = boost::program_options;
 
 po::variables_map parse_arguments(int argc, char *argv[]);
 
-typedef itk::Transform< double, 2, 2 > TransformType;
+typedef GroundTruthError::TransformType TransformType;
 
 TransformType::Pointer readCheckedTransform(string path);
 
@@ -36,55 +35,51 @@ int main( int argc, char * argv[] )
   // with the factory so we add them manually
   itk::TransformFactoryBase::RegisterDefaultTransforms();
   
-  // read transforms
-  TransformType::Pointer perfectTransform1 = readCheckedTransform(vm["perfectTransform1"].as<string>());
-  TransformType::Pointer perfectTransform2 = readCheckedTransform(vm["perfectTransform2"].as<string>());
-  TransformType::Pointer noisyTransform1   = readCheckedTransform(vm["noisyTransform1"].as<string>());
-  TransformType::Pointer noisyTransform2   = readCheckedTransform(vm["noisyTransform2"].as<string>());
-  
-  // calculate the mean Euclidian distance of each non-zero pixel
-  // after being transformed by the two transforms
-  double meanDistance = 0;
-  unsigned int countedPixels = 0, uncountedPixels = 0;
-  
-  typedef unsigned char PixelType;
-  typedef itk::Image< PixelType, 2 > ImageType;
-  typedef itk::ImageRegionConstIterator< ImageType > ConstIteratorType;
-  typedef itk::Point< double, 2 > PointType;
+  // statistics options
+  vector< double > percentiles;
+  if(vm.count("percentiles")) percentiles = vm["percentiles"].as< vector< double > >();
+  const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : 0;
   
+  // compact the non-zero pixels of the mask, which are counted
+  // in the mean Euclidian distance of each pixel after being
+  // transformed by the two transforms
+  typedef GroundTruthError::MaskType ImageType;
   ImageType::Pointer mask = readImage< ImageType >(vm["mask"].as<string>());
-  ImageType::RegionType inputRegion = mask->GetLargestPossibleRegion();
-  ConstIteratorType it(mask, inputRegion);
-  it.GoToBegin();
+  GroundTruthError::MaskPoints points(mask);
   
-  while( !it.IsAtEnd() )
+  if(vm.count("perfectDir"))
   {
-    // if the pixel has a non-zero value,
-    // include it in the calculation of the mean distance
-    if(it.Get())
+    // evaluate every adjacent pair of transforms in the two directories
+    const string perfectDir = vm["perfectDir"].as<string>();
+    const string noisyDir   = vm["noisyDir"  ].as<string>();
+    vector< string > basenames = directoryContents(perfectDir);
+    vector< string > perfectPaths = constructPaths(perfectDir, basenames);
+    vector< string > noisyPaths   = constructPaths(noisyDir,   basenames);
+    
+    for(unsigned int i=0; i+1<basenames.size(); ++i)
     {
-      // calculate original physical position of pixel
-      ImageType::IndexType index = it.GetIndex();
-      PointType physicalPosition;
-      mask->TransformIndexToPhysicalPoint(index, physicalPosition);
+      GroundTruthError::Statistics statistics = GroundTruthError::RelativeError(points,
+        readCheckedTransform(perfectPaths[i]), readCheckedTransform(perfectPaths[i+1]),
+        readCheckedTransform(noisyPaths[i]),   readCheckedTransform(noisyPaths[i+1]),
+        percentiles, threads);
       
-      // add Euclidian distance to total
-      PointType perfectPosition = perfectTransform2->TransformPoint(perfectTransform1->GetInverseTransform()->TransformPoint(physicalPosition));
-      PointType noisyPosition   = noisyTransform2->  TransformPoint(noisyTransform1->  GetInverseTransform()->TransformPoint(physicalPosition));
-      meanDistance += perfectPosition.EuclideanDistanceTo(noisyPosition);
-      
-      ++countedPixels;
-    }
-    else
-    {
-      ++uncountedPixels;
+      cout << basenames[i] << "_" << basenames[i+1] << " ";
+      GroundTruthError::PrintStatistics(cout, statistics, vm.count("percentiles"));
     }
-    ++it;
+  }
+  else
+  {
+    // read transforms
+    TransformType::Pointer perfectTransform1 = readCheckedTransform(vm["perfectTransform1"].as<string>());
+    TransformType::Pointer perfectTransform2 = readCheckedTransform(vm["perfectTransform2"].as<string>());
+    TransformType::Pointer noisyTransform1   = readCheckedTransform(vm["noisyTransform1"].as<string>());
+    TransformType::Pointer noisyTransform2   = readCheckedTransform(vm["noisyTransform2"].as<string>());
+    
+    GroundTruthError::Statistics statistics = GroundTruthError::RelativeError(points,
+      perfectTransform1, perfectTransform2, noisyTransform1, noisyTransform2, percentiles, threads);
+    GroundTruthError::PrintStatistics(cout, statistics, vm.count("percentiles"));
   }
   
-  meanDistance /= countedPixels;
-  
-  cout << meanDistance << endl;
   return EXIT_SUCCESS;
 }
 
@@ -99,6 +94,10 @@ po::variables_map parse_arguments(int argc, char *argv[])
       ("perfectTransform2", po::value<string>(), "second perfect transform")
       ("noisyTransform1", po::value<string>(), "first noisy transform")
       ("noisyTransform2", po::value<string>(), "second noisy transform")
+      ("perfectDir", po::value<string>(), "directory of perfect transforms, evaluated in adjacent pairs instead of single transforms")
+      ("noisyDir", po::value<string>(), "directory of noisy transforms, evaluated in adjacent pairs instead of single transforms")
+      ("percentiles", po::value< vector< double > >()->multitoken(), "also print the maximum and these percentiles of the distances")
+      ("threads", po::value<unsigned int>(), "number of threads, defaulting to ITK's global default")
   ;
   
   po::positional_options_description p;
@@ -129,18 +128,24 @@ po::variables_map parse_arguments(int argc, char *argv[])
   
   // if help is specified, or positional args aren't present,
   // or more than one loadX flag
+  bool directoryMode = vm.count("perfectDir") && vm.count("noisyDir");
   if(    vm.count("help")
      || !vm.count("mask")
-     || !vm.count("perfectTransform1")
-     || !vm.count("perfectTransform2")
-     || !vm.count("noisyTransform1")
-     || !vm.count("noisyTransform2")
+     || ( vm.count("perfectDir") != vm.count("noisyDir") )
+     || ( !directoryMode && !vm.count("perfectTransform1") )
+     || ( !directoryMode && !vm.count("perfectTransform2") )
+     || ( !directoryMode && !vm.count("noisyTransform1") )
+     || ( !directoryMode && !vm.count("noisyTransform2") )
     )
   {
     cerr << "Usage: "
       << argv[0] << " [--mask=]sliceMask.mha"
       << " [--perfectTransform1=]perfect/0001 [[--perfectTransform2=]perfect/0002]"
       << " [--noisyTransform1=]noisy/0001 [[--noisyTransform2=]noisy/0002]"
+      << " [--percentiles 50 90 99]"
+      << endl
+      << "   or: "
+      << argv[0] << " [--mask=]sliceMask.mha --perfectDir perfect --noisyDir noisy"
       << endl << endl;
     cerr << opts << "\n";
     exit(EXIT_FAILURE);
@@ -0,0 +1,211 @@
+// calculate the ground truth errors of a whole stack of noisy transforms
+// against their perfect counterparts, both for each slice and for each adjacent pair,
+// loading the mask once and processing slices in parallel
+
+#include <fstream>
+#include "boost/program_options.hpp"
+
+#include "itkTransformFactory.h"
+#include "itkImage.h"
+
+#include "IOHelpers.hpp"
+#include "GroundTruthError.hpp"
+#include "ParallelFor.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+using GroundTruthError::Affine2D;
+using GroundTruthError::Statistics;
+
+po::variables_map parse_arguments(int argc, char *argv[]);
+void writeMeans(const vector< Statistics >& statistics, const string& fileName);
+
+// absolute error of slice i, and relative error of the pair (i, i+1)
+struct SliceErrors {
+  const GroundTruthError::MaskPoints& points;
+  const vector< Affine2D > &perfect, &noisy, &perfectInverse, &noisyInverse;
+  const vector< double >& percentiles;
+  vector< Statistics > absolute, relative;
+
+  SliceErrors(const GroundTruthError::MaskPoints& p,
+              const vector< Affine2D >& pf, const vector< Affine2D >& n,
+              const vector< Affine2D >& pfi, const vector< Affine2D >& ni,
+              const vector< double >& pc):
+  points(p), perfect(pf), noisy(n), perfectInverse(pfi), noisyInverse(ni), percentiles(pc),
+  absolute(pf.size()), relative(pf.size() > 0 ? pf.size() - 1 : 0) {}
+
+  void operator()(unsigned int i)
+  {
+    // slices are already spread across threads, so each is evaluated on one
+    absolute[i] = GroundTruthError::DisplacementStatistics(points, noisyInverse[i] - perfectInverse[i], percentiles, 1);
+
+    if(i + 1 < perfect.size())
+    {
+      const Affine2D perfectPair = perfectInverse[i].Then( perfect[i+1] );
+      const Affine2D noisyPair   = noisyInverse[i]  .Then( noisy[i+1]   );
+      relative[i] = GroundTruthError::DisplacementStatistics(points, perfectPair - noisyPair, percentiles, 1);
+    }
+  }
+};
+
+int main( int argc, char * argv[] )
+{
+  // Parse command line arguments
+  po::variables_map vm = parse_arguments(argc, argv);
+
+	// Some transforms might not be registered
+  // with the factory so we add them manually
+  itk::TransformFactoryBase::RegisterDefaultTransforms();
+  typedef GroundTruthError::TransformType TransformType;
+
+  vector< double > percentiles;
+  if(vm.count("percentiles")) percentiles = vm["percentiles"].as< vector< double > >();
+  const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : 0;
+
+  // load and compact the mask once for the whole stack
+  typedef GroundTruthError::MaskType ImageType;
+  ImageType::Pointer mask = readImage< ImageType >(vm["mask"].as<string>());
+  GroundTruthError::MaskPoints points(mask);
+
+  // read every transform and reduce it, and its inverse, to an affine matrix
+  const string perfectDir = vm["perfectDir"].as<string>();
+  const string noisyDir   = vm["noisyDir"  ].as<string>();
+  vector< string > basenames = directoryContents(perfectDir);
+  vector< string > perfectPaths = constructPaths(perfectDir, basenames);
+  vector< string > noisyPaths   = constructPaths(noisyDir,   basenames);
+  vector< Affine2D > perfect, noisy, perfectInverse, noisyInverse;
+
+  for(unsigned int i=0; i<basenames.size(); ++i)
+  {
+    itk::TransformBase::Pointer bpPerfectTransform = readTransform(perfectPaths[i]);
+    itk::TransformBase::Pointer bpNoisyTransform   = readTransform(noisyPaths[i]);
+    TransformType::Pointer perfectTransform = dynamic_cast<TransformType*>( bpPerfectTransform.GetPointer() );
+    TransformType::Pointer noisyTransform   = dynamic_cast<TransformType*>( bpNoisyTransform.GetPointer() );
+    assert( perfectTransform != 0 && noisyTransform != 0 );
+
+    perfect.push_back( GroundTruthError::ToAffine(perfectTransform) );
+    noisy.push_back( GroundTruthError::ToAffine(noisyTransform) );
+    perfectInverse.push_back( GroundTruthError::InverseToAffine(perfectTransform) );
+    noisyInverse.push_back( GroundTruthError::InverseToAffine(noisyTransform) );
+  }
+
+  // evaluate slices in parallel
+  SliceErrors errors(points, perfect, noisy, perfectInverse, noisyInverse, percentiles);
+  parallelFor(basenames.size(), errors, threads);
+
+  // print table, with the relative error of each slice and the one after it
+  cout << "slice mean";
+  if(!percentiles.empty())
+  {
+    cout << " max";
+    for(unsigned int p=0; p<percentiles.size(); ++p) cout << " p" << percentiles[p];
+  }
+  cout << " relative_mean";
+  if(!percentiles.empty())
+  {
+    cout << " relative_max";
+    for(unsigned int p=0; p<percentiles.size(); ++p) cout << " relative_p" << percentiles[p];
+  }
+  cout << endl;
+
+  for(unsigned int i=0; i<basenames.size(); ++i)
+  {
+    cout << basenames[i] << " " << errors.absolute[i].mean;
+    if(!percentiles.empty())
+    {
+      cout << " " << errors.absolute[i].max;
+      for(unsigned int p=0; p<percentiles.size(); ++p) cout << " " << errors.absolute[i].percentiles[p];
+    }
+
+    if(i < errors.relative.size())
+    {
+      cout << " " << errors.relative[i].mean;
+      if(!percentiles.empty())
+      {
+        cout << " " << errors.relative[i].max;
+        for(unsigned int p=0; p<percentiles.size(); ++p) cout << " " << errors.relative[i].percentiles[p];
+      }
+    }
+    cout << endl;
+  }
+
+  // optionally write the means in the one-per-line format of the single slice tools
+  if(vm.count("errorsFile"))         writeMeans(errors.absolute, vm["errorsFile"].as<string>());
+  if(vm.count("relativeErrorsFile")) writeMeans(errors.relative, vm["relativeErrorsFile"].as<string>());
+
+  return EXIT_SUCCESS;
+}
+
+void writeMeans(const vector< Statistics >& statistics, const string& fileName)
+{
+  ofstream out(fileName.c_str());
+  if(!out)
+  {
+    cerr << "Couldn't open " << fileName << " for writing." << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  for(unsigned int i=0; i<statistics.size(); ++i)
+  {
+    out << statistics[i].mean << endl;
+  }
+}
+
+po::variables_map parse_arguments(int argc, char *argv[])
+{
+  // Declare the supported options.
+  po::options_description opts("Options");
+  opts.add_options()
+      ("help,h", "produce help message")
+      ("mask", po::value<string>(), "each non-zero pixel is counted in mean displacement")
+      ("perfectDir", po::value<string>(), "directory of perfect transforms")
+      ("noisyDir", po::value<string>(), "directory of noisy transforms, with the same names")
+      ("errorsFile", po::value<string>(), "also write the mean error of each slice to this file")
+      ("relativeErrorsFile", po::value<string>(), "also write the mean relative error of each adjacent pair to this file")
+      ("percentiles", po::value< vector< double > >()->multitoken(), "also print the maximum and these percentiles of the distances")
+      ("threads", po::value<unsigned int>(), "number of threads, defaulting to ITK's global default")
+  ;
+
+  po::positional_options_description p;
+  p.add("mask", 1)
+   .add("perfectDir", 1)
+   .add("noisyDir", 1)
+  ;
+
+  // parse command line
+  po::variables_map vm;
+	try
+	{
+  po::store(po::command_line_parser(argc, argv)
+            .options(opts)
+            .positional(p)
+            .run(),
+            vm);
+	}
+	catch (std::exception& e)
+	{
+	  cerr << "caught command-line parsing error" << endl;
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  po::notify(vm);
+
+  // if help is specified, or positional args aren't present
+  if(    vm.count("help")
+     || !vm.count("mask")
+     || !vm.count("perfectDir")
+     || !vm.count("noisyDir")
+    )
+  {
+    cerr << "Usage: "
+      << argv[0] << " [--mask=]sliceMask.mha"
+      << " [--perfectDir=]perfect [--noisyDir=]noisy"
+      << " [--errorsFile=errors] [--relativeErrorsFile=relative_errors]"
+      << " [--percentiles 50 90 99]"
+      << endl << endl;
+    cerr << opts << "\n";
+    exit(EXIT_FAILURE);
+  }
+
+  return vm;
+}
@@ -9,10 +9,9 @@
 #include "itkTransformFileReader.h"
 #include "itkTransformFileWriter.h"
 #include "itkTransformFactory.h"
-#include "itkCenteredRigid2DTransform.h"
-#include "itkCenteredAffineTransform.h"
 
 #include "IOHelpers.hpp"
+#include "TransformSeries.hpp"
 #include "Dirs.hpp" 
 
 namespace po = boost::program_options;
@@ -56,48 +55,10 @@ int main(int argc, char *argv[]) {
   itk::TransformFactoryBase::RegisterDefaultTransforms();
   // itk::TransformFactory< itk::TranslationTransform< double, 2 > >::RegisterTransform();
   
-	// Generate new transforms
-	// TranslationTransform also has a Compose() interface, but only with other TranslationTransforms
-  typedef itk::MatrixOffsetTransformBase< double, 2, 2 > ComposableTransformType;
-  // typedef itk::CenteredRigid2DTransform< double > OutputTransformType;
-  typedef itk::AffineTransform< double, 2 > OutputTransformType;
-  
-  for(int i=originalPaths.size()-1; i >= 0; --i)
-  {
-    cerr << "unique_basenames[" << i << "]: " << unique_basenames[i] << endl;
-    
-    // create banana transform
-    OutputTransformType::Pointer bananaTransform = OutputTransformType::New();
-    bananaTransform->SetIdentity();
-    
-    // apply all the transforms from i->(i-1) down to (1->0)
-    // for(int j=i; j < originalPaths.size()-1; j++)
-    for(int j=originalPaths.size()-2; j >= i; --j)
-    {
-      // check that original transform is of the right dynamic type
-      itk::TransformBase::Pointer bpAdjustmentTransform = readTransform(adjustmentPaths[j]);
-      ComposableTransformType *pAdjustmentTransform = dynamic_cast<ComposableTransformType*>( bpAdjustmentTransform.GetPointer() );
-      assert( pAdjustmentTransform != 0 );
-      
-      // compose adjustment with banana transform
-      // If the argument pre is true (default false), then other is precomposed with self; that is, the resulting transformation consists of first
-      // applying other to the source, followed by self. If pre is false or omitted, then other is post-composed with self; that is the resulting
-      // transformation consists of first applying self to the source, followed by other. This updates the Translation based on current center.
-      bananaTransform->Compose( pAdjustmentTransform );
-    }
-    
-    // check that original transform is of the right dynamic type
-    itk::TransformBase::Pointer bpOriginalTransform = readTransform(originalPaths[i]);
-    ComposableTransformType *pOriginalTransform = dynamic_cast<ComposableTransformType*>( bpOriginalTransform.GetPointer() );
-    assert( pOriginalTransform != 0 );
-    
-  	// apply the original transforms
-    bananaTransform->Compose(pOriginalTransform);
-  
-    // save output transform
-    writeTransform(bananaTransform, bananaPaths[i]);
-    
-  }
+	// read each series once, then generate and save all banana transforms
+  TransformSeries::ComposableTransformVectorType originals   = TransformSeries::Read(originalPaths);
+  TransformSeries::ComposableTransformVectorType adjustments = TransformSeries::Read(adjustmentPaths);
+  TransformSeries::Write( TransformSeries::ComposeBanana(originals, adjustments), bananaPaths );
   
   return EXIT_SUCCESS;
 }
@@ -9,10 +9,10 @@
 #include "itkTransformFileReader.h"
 #include "itkTransformFileWriter.h"
 #include "itkTransformFactory.h"
-#include "itkAffineTransform.h"
 
 #include "StackTransforms.hpp"
 #include "IOHelpers.hpp"
+#include "TransformSeries.hpp"
 #include "Dirs.hpp" 
 
 namespace po = boost::program_options;
@@ -50,38 +50,13 @@ int main(int argc, char *argv[]) {
   itk::TransformFactoryBase::RegisterDefaultTransforms();
   // itk::TransformFactory< itk::TranslationTransform< double, 2 > >::RegisterTransform();
   
-	// Generate new transforms
-	// TranslationTransform also has a Compose() interface, but only with other TranslationTransforms
-  typedef itk::MatrixOffsetTransformBase< double, 2, 2 > ComposableTransformType;
-  typedef itk::AffineTransform< double, 2 > AffineTransformType;
+  // calculate ROI transform
+  itk::Vector< double, 2 > translation = StackTransforms::GetLoResTranslation("ROI") - StackTransforms::GetLoResTranslation("whole_heart");
   
-  // apply adjustments for every slice
-  for(unsigned int i=0; i < originalPaths.size(); ++i)
-  {
-    // check that transforms are of the right dynamic type
-    itk::TransformBase::Pointer bpOriginalTransform = readTransform(originalPaths[i]);
-    itk::TransformBase::Pointer bpDiffusionTransform = readTransform(diffusionPaths[i]);
-    ComposableTransformType *pOriginalTransform  = dynamic_cast<ComposableTransformType*>( bpOriginalTransform.GetPointer() );
-    ComposableTransformType *pDiffusionTransform = dynamic_cast<ComposableTransformType*>( bpDiffusionTransform.GetPointer() );
-    assert( pOriginalTransform != 0 && pDiffusionTransform != 0 );
-    
-    // calculate ROI transform
-    itk::Vector< double, 2 > translation = StackTransforms::GetLoResTranslation("ROI") - StackTransforms::GetLoResTranslation("whole_heart");
-    
-    // compose transforms
-    // If the argument pre is true (default false), then other is precomposed with self; that is, the resulting transformation consists of first
-    // applying other to the source, followed by self. If pre is false or omitted, then other is post-composed with self; that is the resulting
-    // transformation consists of first applying self to the source, followed by other. This updates the Translation based on current center.
-    AffineTransformType::Pointer adjustedTransform = AffineTransformType::New();
-    adjustedTransform->SetIdentity();
-    adjustedTransform->Translate(-translation);
-    adjustedTransform->Compose(pDiffusionTransform);
-    adjustedTransform->Translate(translation);
-    adjustedTransform->Compose(pOriginalTransform);
-    
-    // save output transform
-    writeTransform(adjustedTransform, adjustedPaths[i]);
-  }
+  // read each series once, then apply adjustments for every slice and save them
+  TransformSeries::ComposableTransformVectorType originals  = TransformSeries::Read(originalPaths);
+  TransformSeries::ComposableTransformVectorType diffusions = TransformSeries::Read(diffusionPaths);
+  TransformSeries::Write( TransformSeries::ComposeAdjusted(originals, diffusions, translation), adjustedPaths );
   
   return EXIT_SUCCESS;
 }
@@ -5,21 +5,19 @@
 #include "boost/filesystem.hpp"
 #include "boost/program_options.hpp"
 
-#include "itkCenteredAffineTransform.h"
-
 #include "Dirs.hpp"
 #include "IOHelpers.hpp"
+#include "TransformDiffusion.hpp"
 
 namespace po = boost::program_options;
 using namespace boost::filesystem;
 using namespace boost;
 
-typedef itk::CenteredAffineTransform< double, 2 > TransformType;
+using namespace TransformDiffusion;
 
 // function declarations
 po::variables_map parse_arguments(int argc, char *argv[]);
 TransformType::Pointer squareRoot(TransformType::Pointer transform);
-TransformType::Pointer interpolateTransforms(TransformType::Pointer a, TransformType::Pointer b, double alpha);
 
 int main(int argc, char *argv[]) {
   po::variables_map vm = parse_arguments(argc, argv);
@@ -53,44 +51,14 @@ int main(int argc, char *argv[]) {
   remove_all(diffusionTransformsDir);
   create_directories(diffusionTransformsDir);
   
-  // first for middle transforms...
-  for(unsigned int i=0; i<pairTransformPaths.size()-1; ++i)
+  // one diffusion transform per slice, named after the slice
+  vector< string > sliceBasenames = SliceBasenames(pairTransformBasenames);
+  for(unsigned int i=0; i<sliceBasenames.size(); ++i)
   {
-    // make sure two transforms share the same slice
-    assert(pairTransformBasenames[i  ].substr(5,4) ==
-           pairTransformBasenames[i+1].substr(0,4));
-    
-    // construct transform
-    TransformType::Pointer belowTransform     = TransformType::New();
-    pairTransforms[i]->GetInverse(belowTransform);
-    TransformType::Pointer aboveTransform     = pairTransforms[i+1];
-    TransformType::Pointer meanTransform      = interpolateTransforms(belowTransform, aboveTransform, 0.5);
-    // interpolate by alpha from identity transform to meanTransform
-    TransformType::Pointer diffusionTransform = TransformType::New();
-    diffusionTransform = interpolateTransforms(diffusionTransform, meanTransform, 2 * alpha);
-    
-    // write transform
-    string diffusionTransformPath = diffusionTransformsDir + pairTransformBasenames[i].substr(5,4);
-    writeTransform(diffusionTransform, diffusionTransformPath);
+    TransformType::Pointer diffusionTransform = computeDiffusionTransform(pairTransforms, i, alpha);
+    writeTransform(diffusionTransform, diffusionTransformsDir + sliceBasenames[i]);
   }
   
-  // ...then for boundary transforms. Since the boundary slices
-  // are just as likely to contain transformational noise, they are not fixed,
-  // but instead diffuse toward their single neighbour, analagously to
-  // zero-Neumann boundary conditions
-  TransformType::Pointer bottomDiffusionTransform = TransformType::New();
-  TransformType::Pointer topDiffusionTransform    = TransformType::New();
-  TransformType::Pointer aboveBottomTransform     = pairTransforms[0];
-  TransformType::Pointer belowTopTransform        = TransformType::New();
-  pairTransforms[pairTransformPaths.size()-1]->GetInverse(belowTopTransform);
-  
-  bottomDiffusionTransform = interpolateTransforms(bottomDiffusionTransform, aboveBottomTransform, alpha);
-  topDiffusionTransform    = interpolateTransforms(topDiffusionTransform,    belowTopTransform,    alpha);
-  string bottomDiffusionTransformPath = diffusionTransformsDir + pairTransformBasenames[0].substr(0,4);
-  string topDiffusionTransformPath    = diffusionTransformsDir + pairTransformBasenames[pairTransformPaths.size()-1].substr(5,4);
-  writeTransform(bottomDiffusionTransform, bottomDiffusionTransformPath);
-  writeTransform(topDiffusionTransform,    topDiffusionTransformPath   );
-  
   return EXIT_SUCCESS;
 }
 
@@ -194,22 +162,3 @@ TransformType::Pointer squareRoot(TransformType::Pointer transform)
   root->SetOffset(o);
   return root;
 }
-
-TransformType::Pointer interpolateTransforms(TransformType::Pointer a, TransformType::Pointer b, double alpha)
-{
-  // extract matrices and offsets
-  TransformType::MatrixType M_a = a->GetMatrix();
-  TransformType::MatrixType M_b = b->GetMatrix();
-  TransformType::OffsetType O_a = a->GetOffset();
-  TransformType::OffsetType O_b = b->GetOffset();
-  
-  // construct new transform from linear interpolation of parameters
-  TransformType::MatrixType M_c = M_a * (1 - alpha) + M_b * alpha;
-  TransformType::OffsetType O_c = O_a * (1 - alpha) + O_b * alpha;
-  
-  TransformType::Pointer c = TransformType::New();
-  c->SetMatrix(M_c);
-  c->SetOffset(O_c);
-  
-  return c;
-}
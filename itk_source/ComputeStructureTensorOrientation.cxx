@@ -0,0 +1,215 @@
+// Computes the absolute magnitudes of the components of the largest eigenvector of
+// a scalar image's structure tensors, as ApplyStructureTensor followed by
+// ExtractLargestEigenvectorComponentsFromTensor, but a slab at a time along the last
+// axis, so that the tensor image is never held whole, or written unless asked, e.g.
+// ComputeStructureTensorOrientation volume.mha orientation mha --sigma=2
+// writes orientation0.mha, orientation1.mha and orientation2.mha.
+// Each slab's tensors are computed with enough of the neighbouring planes that
+// they're those of the whole image. The tensors are smoothed along x only, as
+// ApplyStructureTensor's are, or along every axis with --allAxes, which widens
+// each slab's halo to the Gaussian's radius along the last axis. Compressed
+// MetaImages are read whole, once, as ITK would inflate them from the start for
+// every slab.
+
+// boost
+#include "boost/program_options.hpp"
+
+//itk
+#include "itkRegionOfInterestImageFilter.h"
+
+// my files
+#include "itkStructureTensorImageFilter.h"
+#include "itkExtractLargestEigenvectorFilter.h"
+#include "IOHelpers.hpp"
+
+namespace po = boost::program_options;
+
+po::variables_map parse_arguments(int argc, char *argv[]);
+
+template<unsigned int Dimension>
+void compute_orientation(const po::variables_map& vm)
+{
+  typedef itk::Image< float, Dimension > ImageType;
+  typedef typename ImageType::RegionType RegionType;
+  typedef itk::RegionOfInterestImageFilter< ImageType, ImageType > SlabFilterType;
+  typedef itk::StructureTensorImageFilter< ImageType > TensorFilterType;
+  typedef typename TensorFilterType::OutputImageType TensorImageType;
+  typedef itk::ExtractLargestEigenvectorFilter< TensorImageType > EigenFilterType;
+  typedef typename EigenFilterType::VectorImageType VectorImageType;
+
+  const string inputFile = vm["inputImage"].as<string>();
+  const double sigma = vm["sigma"].as<double>();
+  const bool allAxes = vm["allAxes"].as<bool>();
+  const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : 0;
+  const unsigned int last = Dimension - 1;
+
+  typename ImageType::Pointer information = readImageInformation< ImageType >(inputFile);
+  const RegionType largest = information->GetLargestPossibleRegion();
+  const long length = largest.GetSize(last);
+  if( length == 0 ) return;
+  const unsigned long planePixels = largest.GetNumberOfPixels() / length;
+  const long slabLength = max< long >( 1, vm["slabSize"].as<unsigned long>() * 1000000 / planePixels );
+  const long halo = TensorFilterType::GetHalo( sigma, information->GetSpacing()[last], allAxes );
+
+  // the outputs, filled a slab at a time
+  vector< typename ImageType::Pointer > components(Dimension);
+  for(unsigned int i=0; i<Dimension; ++i)
+  {
+    components[i] = ImageType::New();
+    components[i]->CopyInformation( information );
+    components[i]->SetRegions( largest );
+    components[i]->Allocate();
+  }
+  typename TensorImageType::Pointer tensors;
+  if( vm.count("tensorImage") )
+  {
+    tensors = TensorImageType::New();
+    tensors->CopyInformation( information );
+    tensors->SetRegions( largest );
+    tensors->Allocate();
+  }
+
+  // formats that can't stream, and compressed MetaImages, are read once, whole
+  const bool streams = canStreamRead(inputFile);
+  typename ImageType::Pointer image;
+  if( !streams )
+  {
+    cout << "Reading image..." << flush;
+    image = readImage< ImageType >(inputFile);
+    cout << "done." << endl;
+  }
+
+  cout << "Computing orientation in slabs of " << slabLength << " planes..." << flush;
+  for(long first=0; first<length; first+=slabLength)
+  {
+    const long end = min( first + slabLength, length );
+    const long begin = max( 0L, first - halo ), stop = min( length, end + halo );
+    RegionType region = largest;
+    region.SetIndex( last, largest.GetIndex(last) + begin );
+    region.SetSize( last, stop - begin );
+
+    // the slab and its halo, as an image of its own
+    typename SlabFilterType::Pointer slabFilter = SlabFilterType::New();
+    slabFilter->SetInput( streams ? readImageRegion< ImageType >(inputFile, region, threads) : image );
+    slabFilter->SetRegionOfInterest( region );
+
+    typename TensorFilterType::Pointer tensorFilter = TensorFilterType::New();
+    tensorFilter->SetInput( slabFilter->GetOutput() );
+    tensorFilter->SetSigma( sigma );
+    tensorFilter->SetSmoothAllAxes( allAxes );
+
+    typename EigenFilterType::Pointer eigenFilter = EigenFilterType::New();
+    eigenFilter->SetInput( tensorFilter->GetOutput() );
+
+    if( threads )
+    {
+      slabFilter->SetNumberOfThreads( threads );
+      tensorFilter->SetNumberOfThreads( threads );
+      eigenFilter->SetNumberOfThreads( threads );
+    }
+
+    try {
+      eigenFilter->Update();
+    }
+    catch( itk::ExceptionObject & err ) {
+      cerr << "ExceptionObject caught while computing orientation." << endl;
+      cerr << err << endl;
+      exit(EXIT_FAILURE);
+    }
+
+    // keep the slab's own planes, dropping the halo
+    const unsigned long offset = ( first - begin ) * planePixels, pixels = ( end - first ) * planePixels;
+    const typename VectorImageType::PixelType *vectors = eigenFilter->GetOutput()->GetBufferPointer() + offset;
+    for(unsigned int i=0; i<Dimension; ++i)
+    {
+      float *component = components[i]->GetBufferPointer() + first * planePixels;
+      for(unsigned long k=0; k<pixels; ++k) component[k] = vectors[k][i];
+    }
+    if( tensors )
+    {
+      const typename TensorImageType::PixelType *slabTensors = tensorFilter->GetOutput()->GetBufferPointer() + offset;
+      copy( slabTensors, slabTensors + pixels, tensors->GetBufferPointer() + first * planePixels );
+    }
+  }
+  cout << "done." << endl;
+
+  // write components
+  for(unsigned int i=0; i<Dimension; ++i)
+  {
+    stringstream output;
+    output << vm["outputBase"].as<string>() << i << "." << vm["outputExtension"].as<string>();
+    cout << "Writing component " << i << "..." << flush;
+    writeImage< ImageType >(components[i], output.str());
+    cout << "done." << endl;
+  }
+  if( tensors )
+  {
+    cout << "Writing tensor image..." << flush;
+    writeImage< TensorImageType >(tensors, vm["tensorImage"].as<string>());
+    cout << "done." << endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  po::variables_map vm = parse_arguments(argc, argv);
+
+  if(vm["dimension"].as<unsigned int>() == 2) compute_orientation< 2 >(vm);
+  else compute_orientation< 3 >(vm);
+
+  return EXIT_SUCCESS;
+}
+
+po::variables_map parse_arguments(int argc, char *argv[])
+{
+  // Declare the supported options.
+  po::options_description opts("Options");
+  opts.add_options()
+      ("help,h", "produce help message")
+      ("inputImage", po::value<string>(), "scalar image")
+      ("outputBase", po::value<string>()->default_value("eigencomponent"), "root name of each scalar component output image")
+      ("outputExtension", po::value<string>()->default_value("mha"), "extension of scalar component output images")
+      ("dimension", po::value<unsigned int>()->default_value(3), "number of dimensions in the image")
+      ("sigma", po::value<double>()->default_value(1.0), "standard deviation of the Gaussian smoothing of the tensors")
+      ("allAxes", po::bool_switch(), "smooth the tensors along every axis, rather than along x only")
+      ("tensorImage", po::value<string>(), "also write the whole tensor image here, for debugging")
+      ("slabSize", po::value<unsigned long>()->default_value(16), "millions of pixels to compute at a time, besides each slab's halo")
+      ("threads,t", po::value<unsigned int>(), "number of threads, defaulting to ITK's global default")
+  ;
+
+  po::positional_options_description p;
+  p.add("inputImage", 1)
+   .add("outputBase", 1)
+   .add("outputExtension", 1)
+  ;
+
+  // parse command line
+  po::variables_map vm;
+  try
+  {
+    po::store(po::command_line_parser(argc, argv)
+              .options(opts)
+              .positional(p)
+              .run(),
+              vm);
+  }
+  catch (std::exception& e)
+  {
+    cerr << "caught command-line parsing error" << endl;
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  po::notify(vm);
+
+  // if help is specified, or positional args aren't present
+  const unsigned int dim = vm["dimension"].as<unsigned int>();
+  if(vm.count("help") || !vm.count("inputImage") || dim < 2 || dim > 3 || vm["slabSize"].as<unsigned long>() == 0) {
+    cerr << "Usage: "
+      << argv[0] << " [--inputImage=]volume.mha [[--outputBase=]eigencomponent] "
+      << "[[--outputExtension=]mha] [--sigma=1] [--tensorImage=tensors.vtk]"
+      << endl << endl;
+    cerr << opts << "\n";
+    exit(EXIT_FAILURE);
+  }
+
+  return vm;
+}
@@ -3,6 +3,7 @@
 #include "itkRGBPixel.h"
 #include "itkRGBAPixel.h"
 #include "IOHelpers.hpp"
+#include "RGBAToRGB.hpp"
 
 
 using namespace std;
@@ -28,31 +29,14 @@ int main( int argc, char * argv[] )
   // Read RGBA image from file
   InputImageType::Pointer inputImage = readImage< InputImageType >( inputImageFile );
   
-  // Build RGB image from RGBA image
-  // Initialise output image
-  OutputImageType::RegionType region;
-  region.SetSize( inputImage->GetLargestPossibleRegion().GetSize() );
-  
-  OutputImageType::Pointer outputImage = OutputImageType::New();
-  outputImage->SetRegions( region );
-  outputImage->CopyInformation( inputImage );
-  outputImage->Allocate();
-  
-  // copy values from input image
-  itk::ImageRegionConstIterator< InputImageType > cit(inputImage, region);
-  itk::ImageRegionIterator< OutputImageType >     it(outputImage, region);
-  for (cit.GoToBegin(), it.GoToBegin(); !it.IsAtEnd(); ++cit, ++it ) {
-    it.Value().SetRed( cit.Value().GetGreen() );
-    it.Value().SetGreen( cit.Value().GetBlue() );
-    it.Value().SetBlue( cit.Value().GetAlpha() );
-    
-    // check that actual Alpha channel (even though it's interpreted as Red)
-    // contains only zeros
-    if(cit.Value().GetRed())
-    {
-      cerr << "Non-zero alpha in input image!" << endl;
-      abort();
-    }
+  // Build RGB image from RGBA image, checking that the actual alpha channel
+  // (even though it's interpreted as red) contains only zeros
+  bool alphaIsZero;
+  OutputImageType::Pointer outputImage = RGBAToRGB::Convert< InputImageType, OutputImageType >( inputImage, alphaIsZero );
+  if( !alphaIsZero )
+  {
+    cerr << "Non-zero alpha in input image!" << endl;
+    abort();
   }
   
   // write RGB image to file
@@ -6,9 +6,11 @@
 #include "itkScalarToRGBColormapImageFilter.h"
 #include "itkImageFileWriter.h"
 #include "itkRGBPixel.h"
+#include "itkImageIOFactory.h"
 
 // me
 #include "IOHelpers.hpp"
+#include "IntensityMapping.hpp"
  
 namespace po = boost::program_options;
 
@@ -22,17 +24,38 @@ int main( int argc, char *argv[])
   typedef itk::RGBPixel<unsigned char>    RGBPixelType;
   typedef itk::Image<RGBPixelType, 2>  RGBImageType;
   typedef itk::Image<float, 2>  FloatImageType;
+  typedef itk::Image<unsigned char, 2>  ByteImageType;
   
-  // read in scalar image
-  FloatImageType::Pointer image = readImage<FloatImageType>(vm["inputImage"].as<string>());
+  const string inputImage = vm["inputImage"].as<string>();
+  RGBImageType::Pointer colormap;
   
-  typedef itk::ScalarToRGBColormapImageFilter<FloatImageType, RGBImageType> RGBFilterType;
-  RGBFilterType::Pointer rgbFilter = RGBFilterType::New();
-  rgbFilter->SetInput(image);
-  rgbFilter->SetColormap( RGBFilterType::Jet );
+  // 8-bit images are mapped through a lookup table
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO( inputImage.c_str(), itk::ImageIOFactory::ReadMode );
+  if( imageIO )
+  {
+    imageIO->SetFileName( inputImage );
+    imageIO->ReadImageInformation();
+  }
+  if( imageIO && imageIO->GetComponentType() == itk::ImageIOBase::UCHAR && imageIO->GetNumberOfComponents() == 1 )
+  {
+    ByteImageType::Pointer image = readImage<ByteImageType>(inputImage);
+    unsigned char minimum, maximum;
+    IntensityMapping::FindExtrema( image, minimum, maximum );
+    colormap = IntensityMapping::ApplyJet( image, IntensityMapping::Mapping( minimum, maximum ) );
+  }
+  else
+  {
+    // read in scalar image
+    FloatImageType::Pointer image = readImage<FloatImageType>(inputImage);
+    
+    typedef itk::ScalarToRGBColormapImageFilter<FloatImageType, RGBImageType> RGBFilterType;
+    RGBFilterType::Pointer rgbFilter = RGBFilterType::New();
+    rgbFilter->SetInput(image);
+    rgbFilter->SetColormap( RGBFilterType::Jet );
+    colormap = rgbFilter->GetOutput();
+  }
   
-  RGBImageType::Pointer colormap = rgbFilter->GetOutput();
-  writeImage<RGBImageType>(colormap, vm["outputColormap"].as<string>());
+  writeImage<RGBImageType>(colormap, vm["outputImage"].as<string>());
   
   return EXIT_SUCCESS;
 }
@@ -57,14 +57,14 @@ void doCropImage(po::variables_map vm, typename ImageType::IndexType index, type
 {
   typedef itk::ExtractImageFilter< ImageType, ImageType > CropperType;
   
-  // read input image
-  typename ImageType::Pointer input = readImage< ImageType >(vm["inputImage"].as<string>());
-  
   // construct image subregion
   typename ImageType::RegionType region;
   region.SetIndex(index);
   region.SetSize(size);
   
+  // read as little of the input image as its format allows
+  typename ImageType::Pointer input = readImageRegion< ImageType >(vm["inputImage"].as<string>(), region);
+  
   // extract subimage
   typename CropperType::Pointer cropper = CropperType::New();
   cropper->SetInput(input);
@@ -0,0 +1,151 @@
+// Runs several iterations of diffusion smoothing in memory,
+// equivalent to alternating ComputeDiffusionTransforms and ComposeTransformSeries,
+// but with the pair transforms propagated analytically between iterations
+// rather than re-registered.
+
+#include <boost/lexical_cast.hpp>
+#include "boost/filesystem.hpp"
+#include "boost/program_options.hpp"
+
+#include "itkTransformFactory.h"
+
+#include "StackTransforms.hpp"
+#include "IOHelpers.hpp"
+#include "TransformSeries.hpp"
+#include "TransformDiffusion.hpp"
+#include "Dirs.hpp"
+
+namespace po = boost::program_options;
+using namespace boost::filesystem;
+using namespace boost;
+
+po::variables_map parse_arguments(int argc, char *argv[]);
+
+int main(int argc, char *argv[]) {
+  po::variables_map vm = parse_arguments(argc, argv);
+
+	// Process command line arguments
+  Dirs::SetDataSet( vm["dataSet"].as<string>() );
+  Dirs::SetOutputDirName( vm["outputDir"].as<string>() );
+  const string transformsName = vm["transformsName"].as<string>();
+  const unsigned int firstIteration = vm["iteration"].as<unsigned int>();
+  const unsigned int numberOfIterations = vm["numberOfIterations"].as<unsigned int>();
+  const double alpha = vm["alpha"].as<double>();
+  const bool writeIntermediate = vm["writeIntermediate"].as<bool>();
+
+  // set up directories
+  const string pairsDir     = Dirs::ResultsDir() + "HiResPairs/FinalTransforms/"     + transformsName + "_" + lexical_cast<string>(firstIteration);
+  const string originalDir  = Dirs::ResultsDir() + "HiResPairs/AdjustedTransforms/"  + transformsName + "_" + lexical_cast<string>(firstIteration - 1);
+  const string diffusionDir = Dirs::ResultsDir() + "HiResPairs/DiffusionTransforms/" + transformsName + "_";
+  const string adjustedDir  = Dirs::ResultsDir() + "HiResPairs/AdjustedTransforms/"  + transformsName + "_";
+
+	// Some transforms might not be registered
+  // with the factory so we add them manually
+  itk::TransformFactoryBase::RegisterDefaultTransforms();
+
+  // read pair transforms, and the slices' transforms from the previous iteration
+  vector< string > pairBasenames  = directoryContents(pairsDir);
+  vector< string > sliceBasenames = TransformDiffusion::SliceBasenames(pairBasenames);
+  TransformSeries::ComposableTransformVectorType bpPairTransforms = TransformSeries::Read( constructPaths(pairsDir, pairBasenames) );
+  TransformSeries::ComposableTransformVectorType originals        = TransformSeries::Read( constructPaths(originalDir, sliceBasenames) );
+
+  TransformDiffusion::TransformVectorType pairTransforms;
+  for(unsigned int i=0; i<bpPairTransforms.size(); ++i)
+  {
+    TransformDiffusion::TransformType::Pointer pPairTransform
+      = dynamic_cast< TransformDiffusion::TransformType* >( bpPairTransforms[i].GetPointer() );
+    assert(pPairTransform);
+    pairTransforms.push_back(pPairTransform);
+  }
+
+  // calculate ROI transform
+  itk::Vector< double, 2 > translation = StackTransforms::GetLoResTranslation("ROI") - StackTransforms::GetLoResTranslation("whole_heart");
+
+  TransformDiffusion::Solver solver(pairTransforms, originals, translation, alpha);
+  if( vm.count("threads") ) solver.SetNumberOfThreads( vm["threads"].as<unsigned int>() );
+
+  for(unsigned int k=firstIteration; k<firstIteration + numberOfIterations; ++k)
+  {
+    solver.Iterate();
+
+    // write the final iteration, and optionally every one before it
+    if( writeIntermediate || k == firstIteration + numberOfIterations - 1 )
+    {
+      const string iterationDiffusionDir = diffusionDir + lexical_cast<string>(k);
+      const string iterationAdjustedDir  = adjustedDir  + lexical_cast<string>(k);
+      remove_all(iterationDiffusionDir);
+      remove_all(iterationAdjustedDir);
+      create_directories(iterationDiffusionDir);
+      create_directories(iterationAdjustedDir);
+      TransformSeries::Write( solver.GetDiffusionTransforms(), constructPaths(iterationDiffusionDir, sliceBasenames) );
+      TransformSeries::Write( solver.GetAdjustedTransforms(),  constructPaths(iterationAdjustedDir,  sliceBasenames) );
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+po::variables_map parse_arguments(int argc, char *argv[])
+{
+  // Declare the supported options.
+  po::options_description opts("Options");
+  opts.add_options()
+      ("help,h", "produce help message")
+      ("dataSet", po::value<string>(), "which rat to use")
+      ("outputDir", po::value<string>(), "directory to place results")
+      ("transformsName", po::value<string>(), "name of transform group")
+      ("iteration", po::value<unsigned int>(), "iteration number of the pair transforms to start from")
+      ("numberOfIterations", po::value<unsigned int>()->default_value(1), "number of diffusion iterations to run")
+      ("alpha", po::value<double>()->default_value(0.4), "coefficient of diffusion")
+      ("writeIntermediate", po::bool_switch(), "write the diffusion and adjusted transforms of every iteration, not just the last")
+      ("threads", po::value<unsigned int>(), "number of threads, defaulting to ITK's global default")
+  ;
+
+  po::positional_options_description p;
+  p.add("dataSet", 1)
+   .add("outputDir", 1)
+   .add("transformsName", 1)
+   .add("iteration", 1)
+   .add("numberOfIterations", 1)
+  ;
+
+  // parse command line
+  po::variables_map vm;
+	try
+	{
+  po::store(po::command_line_parser(argc, argv)
+            .options(opts)
+            .positional(p)
+            .run(),
+            vm);
+	}
+	catch (std::exception& e)
+	{
+	  cerr << "caught command-line parsing error" << endl;
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  po::notify(vm);
+
+  // if help is specified, or positional args aren't present
+  if(vm.count("help") ||
+    !vm.count("dataSet") ||
+    !vm.count("outputDir") ||
+    !vm.count("transformsName") ||
+    !vm.count("iteration") ||
+     vm["iteration"].as<unsigned int>() == 0 ||
+     vm["numberOfIterations"].as<unsigned int>() == 0 )
+  {
+    cerr << "Usage: "
+      << argv[0]
+      << " [--dataSet=]RatX [--outputDir=]my_dir"
+      << " [--transformsName=]CenteredAffineTransform"
+      << " [--iteration=]1 [[--numberOfIterations=]10]"
+      << " [--alpha=0.4]"
+      << endl << endl;
+    cerr << opts << "\n";
+    exit(EXIT_FAILURE);
+  }
+
+  return vm;
+}
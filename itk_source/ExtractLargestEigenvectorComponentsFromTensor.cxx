@@ -30,6 +30,8 @@ int main(int argc, char *argv[]) {
   // extract eigenvector
   typedef itk::ExtractLargestEigenvectorFilter< TensorImageType > EigenFilterType;
   EigenFilterType::Pointer eigenFilter = EigenFilterType::New();
+  eigenFilter->SetClosedForm(!vm["iterative"].as<bool>());
+  if(vm.count("threads")) eigenFilter->SetNumberOfThreads(vm["threads"].as<unsigned int>());
   eigenFilter->SetInput(image);
   
   cout << "Extracting largest eigenvectors..." << flush;
@@ -73,6 +75,8 @@ po::variables_map parse_arguments(int argc, char *argv[])
       ("inputImage", po::value<string>(), "input tensor image")
       ("outputBase", po::value<string>()->default_value("eigencomponent"), "root name of each scalar component output image")
       ("outputExtension", po::value<string>()->default_value("mha"), "extension of scalar component output images")
+      ("iterative", po::bool_switch(), "use ITK's general eigen-analysis rather than the closed form")
+      ("threads,t", po::value<unsigned int>(), "number of threads, defaulting to ITK's global default")
   ;
   
   po::positional_options_description p;
@@ -2,9 +2,9 @@
 
 #include "itkImage.h"
 #include "itkRGBPixel.h"
-#include "itkImageFileReader.h"
-#include "itkImageFileWriter.h"
-#include "itkFlipImageFilter.h"
+
+#include "IOHelpers.hpp"
+#include "RotateFlip.hpp"
 
 using namespace std;
 
@@ -18,28 +18,14 @@ int main( int argc, char * argv[] )
 	
   typedef  itk::RGBPixel< unsigned char > PixelType;
   typedef itk::Image< PixelType,  2 >   ImageType;
-  typedef itk::ImageFileReader< ImageType >  ReaderType;
-  typedef itk::ImageFileWriter< ImageType >  WriterType;
-
-  ReaderType::Pointer reader = ReaderType::New();
-  WriterType::Pointer writer = WriterType::New();
-
-  reader->SetFileName( argv[1] );
-  writer->SetFileName( argv[2] );
 
-  typedef itk::FlipImageFilter< ImageType >  FilterType;
-  FilterType::Pointer filter = FilterType::New();
-
-  FilterType::FlipAxesArrayType flipArray;
-	
-  flipArray[0] = 1;
-  flipArray[1] = 0;
+  ImageType::Pointer image = readImage< ImageType >( argv[1] );
+  image->DisconnectPipeline();
 
-  filter->SetFlipAxes( flipArray );
+  // flip in place
+  RotateFlip::Flip< ImageType >( image, 0 );
 
-  filter->SetInput( reader->GetOutput() );
-  writer->SetInput( filter->GetOutput() );
-  writer->Update();
+  writeImage< ImageType >( image, argv[2] );
 
   return EXIT_SUCCESS;
 }
@@ -1,31 +1,137 @@
-#include "itkImageFileReader.h"
+// Prints statistics and percentiles of each of a list of images or volumes, and of
+// all of them together, as tab-separated lines on stdout, e.g.
+// ImageStats --dimension=3 --percentiles 1 50 99 --histogram=histogram.txt volume.mha
+// Images are read a slab at a time where their format allows, so needn't fit in memory;
+// compressed MetaImages are read whole, once.
+
+#include "boost/program_options.hpp"
+
+#include "itkImage.h"
 
 // my files
 #include "ImageStats.hpp"
+#include "BatchProcessor.hpp"
 
 using namespace std;
+namespace po = boost::program_options;
+
+po::variables_map parse_arguments(int argc, char *argv[]);
 
-int main( int argc, char ** argv )
+void printStats(const string& name, const ImageStats::Accumulator& accumulator, const vector< double >& percentiles)
 {
-  if( argc < 2 )
+  cout << name << "\t" << accumulator.GetCount() << "\t" << accumulator.GetMinimum() << "\t" << accumulator.GetMaximum()
+       << "\t" << accumulator.GetMean() << "\t" << accumulator.GetSigma() << "\t" << accumulator.GetSum();
+  for(unsigned int i=0; i<percentiles.size(); ++i) cout << "\t" << accumulator.GetPercentile(percentiles[i]);
+  cout << endl;
+
+  if( accumulator.GetBelow() || accumulator.GetAbove() )
   {
-    std::cerr << "Usage:" << std::endl;
-    std::cerr << argv[0] << " inputImageFile" << std::endl;
-    return EXIT_FAILURE;
+    cerr << name << ": " << accumulator.GetBelow() << " values below and " << accumulator.GetAbove()
+         << " above the histogram's range, so percentiles there are approximate." << endl;
   }
+}
 
-  typedef unsigned char      PixelType;
-  const   unsigned int        Dimension = 2;
-  typedef itk::Image< PixelType, Dimension > ImageType;
-  typedef itk::ImageFileReader< ImageType > ReaderType;
+template <unsigned int Dimension>
+void doImageStats(const po::variables_map& vm, const vector< string >& inputs)
+{
+  typedef itk::Image< float, Dimension > ImageType;
 
-  ReaderType::Pointer reader = ReaderType::New();
+  const ImageStats::HistogramRange range(vm["lower"].as<double>(), vm["upper"].as<double>(), vm["bins"].as<unsigned int>());
+  const vector< double > percentiles = vm["percentiles"].as< vector< double > >();
+  const unsigned long slabPixels = vm["slabSize"].as<unsigned long>() * 1000000;
+  const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : 0;
 
-  const char * inputFilename  = argv[1];
+  cout << "image\tpixels\tminimum\tmaximum\tmean\tsigma\tsum";
+  for(unsigned int i=0; i<percentiles.size(); ++i) cout << "\tp" << percentiles[i];
+  cout << endl;
+
+  ImageStats::Accumulator total(range);
+  for(unsigned int i=0; i<inputs.size(); ++i)
+  {
+    ImageStats::Accumulator accumulator(range);
+    ImageStats::AccumulateFile< ImageType >(inputs[i], accumulator, slabPixels, threads);
+    printStats(inputs[i], accumulator, percentiles);
+    total.Merge(accumulator);
+  }
+  if( inputs.size() > 1 ) printStats("total", total, percentiles);
+
+  if( vm.count("histogram") )
+  {
+    ofstream histogram(vm["histogram"].as<string>().c_str());
+    for(unsigned int bin=0; bin<range.bins; ++bin)
+    {
+      histogram << range.BinLower(bin) << "\t" << total.GetHistogram()[bin] << "\n";
+    }
+  }
+}
+
+int main( int argc, char * argv[] )
+{
+  po::variables_map vm = parse_arguments(argc, argv);
+
+  vector< string > inputs, outputs;
+  if( vm.count("inputImages") ) inputs = vm["inputImages"].as< vector< string > >();
+  if( vm.count("list") ) BatchProcessor::ReadList(vm["list"].as<string>(), inputs, outputs);
+
+  if( vm["dimension"].as<unsigned int>() == 2 ) doImageStats< 2 >(vm, inputs);
+  else doImageStats< 3 >(vm, inputs);
 
-  reader->SetFileName( inputFilename );
-  
-  printImageStats< ImageType >( reader->GetOutput() );
-  
   return EXIT_SUCCESS;
 }
+
+po::variables_map parse_arguments(int argc, char *argv[])
+{
+  const double defaultPercentiles[] = { 1, 5, 50, 95, 99 };
+  
+  // Declare the supported options.
+  po::options_description opts("Options");
+  opts.add_options()
+      ("help,h", "produce help message")
+      ("inputImages", po::value< vector< string > >(), "images or volumes to summarise")
+      ("list", po::value<string>(), "file of images to summarise, one per line")
+      ("dimension", po::value<unsigned int>()->default_value(2), "dimensionality of the images, 2 or 3")
+      ("percentiles", po::value< vector< double > >()->multitoken()->default_value(vector< double >(defaultPercentiles, defaultPercentiles + 5), "1 5 50 95 99"), "percentiles to report")
+      ("lower", po::value<double>()->default_value(0), "lower edge of the histogram")
+      ("upper", po::value<double>()->default_value(256), "upper edge of the histogram")
+      ("bins", po::value<unsigned int>()->default_value(256), "number of histogram bins; the default gives exact percentiles of 8-bit images")
+      ("histogram", po::value<string>(), "file to write the histogram of all the images to, as tab-separated bin lower edges and counts")
+      ("slabSize", po::value<unsigned long>()->default_value(16), "millions of pixels to read at a time, where the format allows")
+      ("threads,t", po::value<unsigned int>(), "number of threads, defaulting to ITK's global default")
+  ;
+
+  po::positional_options_description p;
+  p.add("inputImages", -1);
+
+  // parse command line
+  po::variables_map vm;
+  try
+  {
+    po::store(po::command_line_parser(argc, argv)
+              .options(opts)
+              .positional(p)
+              .run(),
+              vm);
+  }
+  catch (std::exception& e)
+  {
+    cerr << "caught command-line parsing error" << endl;
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  po::notify(vm);
+
+  // if help is specified, or there's nothing to summarise
+  const unsigned int dimension = vm["dimension"].as<unsigned int>();
+  if( vm.count("help") || ( !vm.count("inputImages") && !vm.count("list") ) ||
+      ( dimension != 2 && dimension != 3 ) || vm["bins"].as<unsigned int>() == 0 ||
+      vm["upper"].as<double>() <= vm["lower"].as<double>() || vm["slabSize"].as<unsigned long>() == 0 )
+  {
+    cerr << "Usage: "
+      << argv[0] << " [--inputImages=]image1 [image2...] [--list=images.txt] [options]"
+      << endl << endl;
+    cerr << opts << "\n";
+    exit(EXIT_FAILURE);
+  }
+
+  return vm;
+}
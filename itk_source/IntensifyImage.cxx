@@ -2,11 +2,9 @@
 
 #include "boost/program_options.hpp"
 
-#include "itkInvertIntensityImageFilter.h"
-#include "itkRescaleIntensityImageFilter.h"
-
 #include "IOHelpers.hpp"
 #include "ImageStats.hpp"
+#include "IntensityMapping.hpp"
 
 using namespace std;
 namespace po = boost::program_options;
@@ -23,26 +21,18 @@ int main( int argc, char * argv[] )
   
   ImageType::Pointer input = readImage< ImageType >( vm["inputFile"].as<string>() );
   
-  // invert intensity
+  // invert then rescale intensity, composed into one lookup table
+  unsigned char minimum, maximum;
+  IntensityMapping::FindExtrema( input, minimum, maximum );
+  IntensityMapping::Mapping mapping( minimum, maximum );
+  
   if(!vm["no-invert"].as<bool>())
   {
-    typedef itk::InvertIntensityImageFilter <ImageType> InverterType;
-    
-    InverterType::Pointer inverter = InverterType::New();
-    // inverter->SetMaximum(50); // default 255
-    inverter->SetInput(input);
-    inverter->Update();
-    input = inverter->GetOutput();
+    mapping.Invert();
   }
+  mapping.Rescale( vm["min"].as<unsigned int>(), vm["max"].as<unsigned int>() );
   
-  // rescale intensity
-  typedef itk::RescaleIntensityImageFilter< ImageType, ImageType > IntensifierType;
-  IntensifierType::Pointer intensifier = IntensifierType::New();
-  intensifier->SetInput( input );
-  intensifier->SetOutputMinimum(vm["min"].as<unsigned int>());
-  intensifier->SetOutputMaximum(vm["max"].as<unsigned int>());
-  
-  ImageType::Pointer output = intensifier->GetOutput();
+  ImageType::Pointer output = IntensityMapping::Apply( input, mapping );
   writeImage< ImageType >( output, vm["outputFile"].as<string>() );
   
   printImageStats<ImageType>(output);
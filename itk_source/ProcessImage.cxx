@@ -0,0 +1,77 @@
+// Prepares an RGB image with a sequence of operations, reading it once
+// and writing only the result, e.g.
+// ProcessImage original.bmp prepared.bmp rotate crop:100,200,4000,3000 pad:8,8,0,0,255
+
+#include "boost/program_options.hpp"
+
+#include "ImageOperations.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+
+po::variables_map parse_arguments(int argc, char *argv[]);
+
+int main( int argc, char * argv[] )
+{
+  po::variables_map vm = parse_arguments(argc, argv);
+  
+  vector< string > specifications;
+  if( vm.count("operations") ) specifications = vm["operations"].as< vector< string > >();
+  const vector< ImageOperations::Operation > operations = ImageOperations::Parse(specifications);
+  
+  ImageOperations::ImageType::Pointer output = ImageOperations::Run( vm["inputFile"].as<string>(), operations );
+  writeImage< ImageOperations::ImageType >( output, vm["outputFile"].as<string>() );
+  
+  return EXIT_SUCCESS;
+}
+
+po::variables_map parse_arguments(int argc, char *argv[])
+{
+  // Declare the supported options.
+  po::options_description opts("Options");
+  opts.add_options()
+      ("help,h", "produce help message")
+      ("inputFile", po::value<string>(), "image to prepare")
+      ("outputFile", po::value<string>(), "result of the operations")
+      ("operations", po::value< vector< string > >()->multitoken(), "operations to apply, in order")
+  ;
+  
+  po::positional_options_description p;
+  p.add("inputFile", 1)
+   .add("outputFile", 1)
+   .add("operations", -1);
+  
+  // parse command line
+  po::variables_map vm;
+	try
+	{
+  po::store(po::command_line_parser(argc, argv)
+            .options(opts)
+            .positional(p)
+            .run(),
+            vm);
+	}
+	catch (std::exception& e)
+	{
+	  cerr << "caught command-line parsing error" << endl;
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  po::notify(vm);
+  
+  // if help is specified, or positional args aren't present
+  if(    vm.count("help")
+     || !vm.count("inputFile")
+     || !vm.count("outputFile")
+    )
+  {
+    cerr << "Usage: "
+      << argv[0] << " [--inputFile=]original.bmp [--outputFile=]prepared.bmp [--operations=]rotate crop:x,y,width,height ..."
+      << endl << endl;
+    cerr << opts << endl;
+    cerr << "Operations:" << endl << ImageOperations::Usage();
+    exit(EXIT_FAILURE);
+  }
+  
+  return vm;
+}
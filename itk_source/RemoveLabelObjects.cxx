@@ -1,3 +1,9 @@
+// Removes connected components of a binary volume's foreground, either those smaller
+// than --lambda, or all but the --number largest, by the given shape attribute.
+// NumberOfPixels and PhysicalSize are found by run-length encoded union-find, which
+// needs a fraction of the time and memory of ITK's label maps; other attributes, or
+// --labelMap, use ITK's BinaryShapeOpeningImageFilter and BinaryShapeKeepNObjectsImageFilter.
+
 #include "boost/program_options.hpp"
 
 #include "itkSimpleFilterWatcher.h"
@@ -6,6 +12,7 @@
 #include "itkBinaryShapeKeepNObjectsImageFilter.h"
 
 #include "IOHelpers.hpp"
+#include "BinaryComponents.hpp"
 
 namespace po = boost::program_options;
 
@@ -28,6 +35,39 @@ typename OpeningType::Pointer buildOpener(const po::variables_map& vm)
   return opener;
 }
 
+// removes components in place, computing only their sizes
+template<typename ImageType>
+void removeBySize(ImageType* image, const po::variables_map& vm)
+{
+  const unsigned int threads = vm.count("threads") ? vm["threads"].as<unsigned int>() : 0;
+  const bool reverseOrdering = vm["reverseOrdering"].as<bool>();
+
+  cout << "Labelling components..." << flush;
+  BinaryComponents::RunLengths runLengths;
+  BinaryComponents::Encode( image->GetBufferPointer(), image->GetBufferedRegion().GetSize(),
+                            vm["foreground"].as<unsigned int>(), runLengths, threads );
+  vector< unsigned long > labels, sizes;
+  BinaryComponents::Label( runLengths, vm["fullyConnected"].as<bool>(), labels, sizes, threads );
+  cout << "done, " << sizes.size() << " found." << endl;
+
+  vector< bool > keep;
+  if(vm.count("lambda"))
+  {
+    double pixelSize = 1;
+    if(vm["attribute"].as<string>() == "PhysicalSize")
+      for(unsigned int i=0; i<ImageType::ImageDimension; ++i) pixelSize *= image->GetSpacing()[i];
+    keep = BinaryComponents::KeepBySize( sizes, pixelSize, vm["lambda"].as<double>(), reverseOrdering );
+  }
+  else
+  {
+    keep = BinaryComponents::KeepLargest( sizes, vm["number"].as<unsigned int>(), reverseOrdering );
+  }
+
+  cout << "Removing components..." << flush;
+  BinaryComponents::Clear( image->GetBufferPointer(), runLengths, labels, keep, vm["background"].as<unsigned int>(), threads );
+  cout << "done." << endl;
+}
+
 int main(int argc, char * argv[])
 {
   po::variables_map vm = parse_arguments(argc, argv);
@@ -35,11 +75,18 @@ int main(int argc, char * argv[])
   typedef itk::Image< unsigned char, 3 > ImageType;
   
   cout << "Reading image..." << flush;
-  ImageType::Pointer input = readImage< ImageType >( argv[1] );
+  ImageType::Pointer input = readImage< ImageType >( vm["input"].as<string>() );
   cout << "done." << endl;
   ImageType::Pointer output;
   
-  if(vm.count("lambda"))
+  const string attribute = vm["attribute"].as<string>();
+  if(!vm["labelMap"].as<bool>() && (attribute == "NumberOfPixels" || attribute == "PhysicalSize"))
+  // filter by size, without a label map
+  {
+    removeBySize< ImageType >(input, vm);
+    output = input;
+  }
+  else if(vm.count("lambda"))
   // filter by attribute
   {
     typedef itk::BinaryShapeOpeningImageFilter< ImageType > OpeningType;
@@ -108,6 +155,8 @@ po::variables_map parse_arguments(int argc, char *argv[])
       ("background", po::value<unsigned int>()->default_value(0),   "background pixel value")
       ("foreground", po::value<unsigned int>()->default_value(255), "foreground pixel value")
       ("fullyConnected", po::bool_switch(), "whether to use strict face or face+edge+vertex connectivity")
+      ("labelMap", po::bool_switch(), "use ITK's label map filters even for NumberOfPixels and PhysicalSize")
+      ("threads,t", po::value<unsigned int>(), "number of threads, defaulting to ITK's global default")
   ;
   
   po::positional_options_description p;
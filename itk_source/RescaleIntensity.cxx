@@ -3,11 +3,9 @@
 // boost
 #include "boost/program_options.hpp"
 
-// itk
-#include "itkRescaleIntensityImageFilter.h"
-
 // my files
 #include "IOHelpers.hpp"
+#include "IntensityMapping.hpp"
 
 namespace po = boost::program_options;
 
@@ -19,19 +17,18 @@ int main(int argc, char *argv[]) {
   // typedefs
   typedef unsigned char PixelType;
   typedef itk::Image< PixelType, 2 > ImageType;
-  typedef itk::RescaleIntensityImageFilter< ImageType, ImageType > RescalerType;
   
   // read image
   ImageType::Pointer image = readImage< ImageType >(vm["inputImage"].as<string>());
   
-  // set up composer
-  RescalerType::Pointer rescaler = RescalerType::New();
-  rescaler->SetInput(image);
-  rescaler->SetOutputMinimum(0);
-  rescaler->SetOutputMaximum(vm["maximumIntensity"].as<unsigned int>());
+  // rescale through a lookup table
+  unsigned char minimum, maximum;
+  IntensityMapping::FindExtrema( image, minimum, maximum );
+  IntensityMapping::Mapping mapping( minimum, maximum );
+  mapping.Rescale( 0, vm["maximumIntensity"].as<unsigned int>() );
   
   // save image
-  ImageType::Pointer output = rescaler->GetOutput();
+  ImageType::Pointer output = IntensityMapping::Apply( image, mapping );
   writeImage< ImageType >(output, vm["outputImage"].as<string>());
   
   return EXIT_SUCCESS;
@@ -2,10 +2,9 @@
 
 #include "itkImage.h"
 #include "itkRGBPixel.h"
-#include "itkFlipImageFilter.h"
-#include "itkPermuteAxesImageFilter.h"
 
 #include "IOHelpers.hpp"
+#include "RotateFlip.hpp"
 
 using namespace std;
 
@@ -22,33 +21,12 @@ int main( int argc, char * argv[] )
   
   ImageType::Pointer input = readImage< ImageType >( argv[1] );
 
-  // Permute the x and y axes, i.e. flip the images through x = y
-  typedef itk::PermuteAxesImageFilter< ImageType >  PermuteAxesType;
-  PermuteAxesType::Pointer permuter = PermuteAxesType::New();
-
-  PermuteAxesType::PermuteOrderArrayType permuteArray;
-	
-  permuteArray[0] = 1;
-  permuteArray[1] = 0;
-  
-  permuter->SetOrder( permuteArray );
-
-  permuter->SetInput( input );
-  
-  // Flip the images through vertical axis
-  typedef itk::FlipImageFilter< ImageType >  FlipImageType;
-  FlipImageType::Pointer flipper = FlipImageType::New();
-
-  FlipImageType::FlipAxesArrayType flipArray;
-	
-  flipArray[0] = 1;
-  flipArray[1] = 0;
-
-  flipper->SetFlipAxes( flipArray );
-
-  flipper->SetInput( permuter->GetOutput() );
+  // Permute the x and y axes, i.e. flip the images through x = y,
+  // then flip the images through vertical axis, in a single pass
+  ImageType::Pointer output = RotateFlip::RotateClockwise< ImageType >( input );
   
-  ImageType::Pointer output = flipper->GetOutput();
+  // free the input before the output is written
+  input = 0;
   writeImage< ImageType >( output, argv[2] );
 
   return EXIT_SUCCESS;
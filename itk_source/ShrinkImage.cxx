@@ -1,139 +1,86 @@
 // Smoothes and Downsamples RGB image
+// Given a strip height, the output is built a strip of rows at a time, so that only
+// one strip's smoothed intermediates are held in memory at once; see Shrinker.hpp.
 
-#include "itkImage.h"
-#include "itkRGBPixel.h"
-#include "itkImageFileReader.h"
-#include "itkImageFileWriter.h"
-// #include "itkResampleImageFilter.h"
-#include "itkVectorResampleImageFilter.h"
-#include "itkIdentityTransform.h"
-// #include "itkLinearInterpolateImageFunction.h"
-#include "itkVectorLinearInterpolateImageFunction.h"
-#include "itkRecursiveGaussianImageFilter.h"
-#include "itkCastImageFilter.h"
+#include "boost/program_options.hpp"
+
+#include "Shrinker.hpp"
 
 using namespace std;
+namespace po = boost::program_options;
+
+po::variables_map parse_arguments(int argc, char *argv[]);
 
 int main( int argc, char * argv[] )
 {
-  if( argc < 4 ) {
-    cerr << "Usage: " << endl;
-    cerr << argv[0] << "  inputImageFile  outputImageFile downsampleRatio" << endl;
-    exit(EXIT_FAILURE);
-  }
-  
-  const     unsigned int   Dimension = 2;
-  
-  // typedef   unsigned char  InputPixelType;
-  // typedef   float          InternalPixelType;
-  // typedef   unsigned short OutputPixelType;
-	typedef itk::RGBPixel< unsigned char >	PixelType;
-  typedef PixelType InputPixelType;
-  typedef PixelType InternalPixelType;
-  typedef PixelType OutputPixelType;
-  
-  typedef itk::Image< InputPixelType,    Dimension > InputImageType;
-  typedef itk::Image< InternalPixelType, Dimension > InternalImageType;
-  typedef itk::Image< OutputPixelType,   Dimension > OutputImageType;
-  
-  typedef itk::ImageFileReader< InputImageType  > ReaderType;
-  typedef itk::ImageFileWriter< OutputImageType > WriterType;
-  
-  ReaderType::Pointer reader = ReaderType::New();
-  WriterType::Pointer writer = WriterType::New();
-  
-  reader->SetFileName( argv[1] );
-  writer->SetFileName( argv[2] );
-  
-  const double factor = atoi(argv[3]);
-  
+  po::variables_map vm = parse_arguments(argc, argv);
+
   try {
-    reader->Update();
+    // number of output rows computed at once, 0 meaning the whole image
+    Shrinker::ShrinkFile( vm["inputFile"].as<string>(), vm["outputFile"].as<string>(),
+                          vm["downsampleRatio"].as<unsigned int>(), vm["stripHeight"].as<unsigned int>(),
+                          vm["fused"].as<bool>() );
   }
   catch( itk::ExceptionObject & excep ) {
     cerr << "Exception caught!" << endl;
     cerr << excep << endl;
     exit(EXIT_FAILURE);
   }
-  
-  InputImageType::ConstPointer inputImage = reader->GetOutput();
-  
-  typedef itk::CastImageFilter< InputImageType, InternalImageType > CastFilterType;
-  CastFilterType::Pointer caster = CastFilterType::New();
-  caster->SetInput( inputImage );
-	
-  typedef itk::RecursiveGaussianImageFilter< InternalImageType, InternalImageType > GaussianFilterType;
-	
-  GaussianFilterType::Pointer smootherX = GaussianFilterType::New();
-  GaussianFilterType::Pointer smootherY = GaussianFilterType::New();
-	
-  // smootherX->SetInput( caster->GetOutput() );
-  smootherX->SetInput( reader->GetOutput() ); // skip caster
-  smootherY->SetInput( smootherX->GetOutput() );
-	
-  // The Sigma values to use in the smoothing filters is computed based on the
-  // pixel spacings of the input image and the factors provided as arguments.
-
-  const InputImageType::SpacingType& inputSpacing = inputImage->GetSpacing();
-
-  const double sigmaX = inputSpacing[0] * factor;
-  const double sigmaY = inputSpacing[1] * factor;
-
-  smootherX->SetSigma( sigmaX );
-  smootherY->SetSigma( sigmaY );
-
-  smootherX->SetDirection( 0 );
-  smootherY->SetDirection( 1 );
-  
-  smootherX->SetNormalizeAcrossScale( false );
-  smootherY->SetNormalizeAcrossScale( false );
-  
-  typedef itk::VectorResampleImageFilter< InternalImageType, OutputImageType > ResampleFilterType;
-  ResampleFilterType::Pointer resampler = ResampleFilterType::New();
-
-  typedef itk::IdentityTransform< double, Dimension > TransformType;
-
-  TransformType::Pointer transform = TransformType::New();
-  transform->SetIdentity();
-  resampler->SetTransform( transform );
-  
-  typedef itk::VectorLinearInterpolateImageFunction< InternalImageType, double >  InterpolatorType;
-  InterpolatorType::Pointer interpolator = InterpolatorType::New();
-  resampler->SetInterpolator( interpolator );
-  
-  // resampler->SetDefaultPixelValue( 0 );
-  
-  OutputImageType::SpacingType spacing;
-
-  spacing[0] = inputSpacing[0] * factor;
-  spacing[1] = inputSpacing[1] * factor;
-
-  resampler->SetOutputSpacing( spacing );
-  resampler->SetOutputOrigin( inputImage->GetOrigin() );
-  resampler->SetOutputDirection( inputImage->GetDirection() );
-
-  InputImageType::SizeType inputSize = inputImage->GetLargestPossibleRegion().GetSize();
 
-  typedef InputImageType::SizeType::SizeValueType SizeValueType;
-  InputImageType::SizeType size;
-
-  size[0] = static_cast< SizeValueType >( inputSize[0] / factor );
-  size[1] = static_cast< SizeValueType >( inputSize[1] / factor );
-
-  resampler->SetSize( size );
-
-  resampler->SetInput( smootherY->GetOutput() );
+  return EXIT_SUCCESS;
+}
 
-  writer->SetInput( resampler->GetOutput() );
-  
-  try {
-    writer->Update();
+po::variables_map parse_arguments(int argc, char *argv[])
+{
+  // Declare the supported options.
+  po::options_description opts("Options");
+  opts.add_options()
+      ("help,h", "produce help message")
+      ("inputFile", po::value<string>(), "input image")
+      ("outputFile", po::value<string>(), "output image")
+      ("downsampleRatio", po::value<unsigned int>(), "downsample ratio, also the Gaussian's sigma in input pixels")
+      ("stripHeight", po::value<unsigned int>()->default_value(0), "number of output rows to compute at once, 0 for the whole image")
+      ("fused", po::bool_switch(), "smooth at the output samples only, with a truncated Gaussian rather than the recursive filters")
+  ;
+
+  po::positional_options_description p;
+  p.add("inputFile", 1)
+   .add("outputFile", 1)
+   .add("downsampleRatio", 1)
+   .add("stripHeight", 1);
+
+  // parse command line
+  po::variables_map vm;
+	try
+	{
+  po::store(po::command_line_parser(argc, argv)
+            .options(opts)
+            .positional(p)
+            .run(),
+            vm);
+	}
+	catch (std::exception& e)
+	{
+	  cerr << "caught command-line parsing error" << endl;
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
   }
-  catch( itk::ExceptionObject & excep ) {
-    cerr << "Exception caught!" << endl;
-    cerr << excep << endl;
+  po::notify(vm);
+
+  // if help is specified, or positional args aren't present
+  if(    vm.count("help")
+     || !vm.count("inputFile")
+     || !vm.count("outputFile")
+     || !vm.count("downsampleRatio")
+     || vm["downsampleRatio"].as<unsigned int>() == 0
+    )
+  {
+    cerr << "Usage: "
+      << argv[0] << " [--inputFile=]original.bmp [--outputFile=]downsample.bmp [--downsampleRatio=]8 [[--stripHeight=]256] [--fused]"
+      << endl << endl;
+    cerr << opts << "\n";
     exit(EXIT_FAILURE);
   }
-	
-  return EXIT_SUCCESS;
+
+  return vm;
 }
@@ -49,6 +49,7 @@ po::variables_map parse_arguments(int argc, char *argv[])
       ("outputExtension,e", po::value<string>()->default_value("bmp"), "filetype extension of output slices")
       ("latex,l", po::bool_switch(), "shrink pixel spacings so images fit in a Latex document")
       ("slice,s", po::value<unsigned int>(), "pick a single slice number to output")
+      ("threads,t", po::value<unsigned int>(), "number of slices to write at once, defaulting to ITK's global default number of threads")
   ;
   
   po::positional_options_description p;
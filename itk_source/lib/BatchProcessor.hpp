@@ -0,0 +1,246 @@
+// Applies one operation to many images in a single process, several at a time,
+// so that ITK starts up once and one image's reading or writing overlaps another's
+// processing. Images come from a list file of tab-separated input and output paths,
+// or from a pair of directories; operations that only read, such as statistics,
+// just need inputs. Outputs newer than their inputs are skipped, so
+// interrupted runs can be restarted, outputs only appear once complete, and a
+// status line is printed for each image as it finishes:
+// ok|skipped|failed <tab> input <tab> output
+// followed by a summary of throughput and failures.
+
+#ifndef BATCHPROCESSOR_HPP_
+#define BATCHPROCESSOR_HPP_
+
+#include <fstream>
+#include <stdexcept>
+#include "boost/program_options.hpp"
+#include "boost/filesystem.hpp"
+
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageIOFactory.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkTimeProbe.h"
+
+#include "IOHelpers.hpp"
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace BatchProcessor {
+  namespace po = boost::program_options;
+  namespace fs = boost::filesystem;
+
+  // the options every batch tool takes
+  inline po::options_description Options()
+  {
+    po::options_description opts("Batch options");
+    opts.add_options()
+        ("list", po::value<string>(), "file of tab-separated input and output paths, one pair per line")
+        ("inputDir", po::value<string>(), "process every image in this directory...")
+        ("outputDir", po::value<string>(), "...into this one, with the same names")
+        ("threads", po::value<unsigned int>(), "number of images to process at once, defaulting to ITK's global default number of threads")
+        ("force", po::bool_switch(), "process images even if their output is up to date")
+    ;
+    return opts;
+  }
+
+  // exactly one of a list or pair of directories
+  inline bool OptionsAreValid(const po::variables_map& vm, bool needsOutputs = true)
+  {
+    return vm.count("list") != vm.count("inputDir") &&
+           ( vm.count("inputDir") == vm.count("outputDir") || ( !needsOutputs && !vm.count("outputDir") ) );
+  }
+
+  // one tab-separated input and output path per line, or just an input
+  inline void ReadList(const string& listFile, vector< string >& inputs, vector< string >& outputs)
+  {
+    ifstream list(listFile.c_str());
+    if( !list )
+    {
+      cerr << "Couldn't open " << listFile << endl;
+      exit(EXIT_FAILURE);
+    }
+
+    string line;
+    while( getline(list, line) )
+    {
+      if( line.empty() ) continue;
+      const string::size_type tab = line.find('\t');
+      inputs.push_back( line.substr(0, tab) );
+      outputs.push_back( tab == string::npos ? "" : line.substr(tab + 1) );
+    }
+  }
+
+  // the visible files of inputDir, each with the same name in outputDir, if given
+  inline void ListDirectory(const string& inputDir, const string& outputDir, vector< string >& inputs, vector< string >& outputs)
+  {
+    if( !outputDir.empty() ) fs::create_directories(outputDir);
+
+    vector< string > basenames = directoryContents(inputDir);
+    for(unsigned int i=0; i<basenames.size(); ++i)
+    {
+      const string input = inputDir + "/" + basenames[i];
+      if( basenames[i][0] != '.' && fs::is_regular_file(input) )
+      {
+        inputs.push_back(input);
+        outputs.push_back(outputDir.empty() ? "" : outputDir + "/" + basenames[i]);
+      }
+    }
+  }
+
+  inline void GetImages(const po::variables_map& vm, vector< string >& inputs, vector< string >& outputs)
+  {
+    if( vm.count("list") )
+    {
+      ReadList(vm["list"].as<string>(), inputs, outputs);
+    }
+    else
+    {
+      ListDirectory(vm["inputDir"].as<string>(), vm.count("outputDir") ? vm["outputDir"].as<string>() : "", inputs, outputs);
+    }
+  }
+
+  inline bool UpToDate(const string& input, const string& output)
+  {
+    try {
+      return fs::exists(output) && fs::last_write_time(output) >= fs::last_write_time(input);
+    }
+    catch( std::exception & ) {
+      return false;
+    }
+  }
+
+  // a hidden file alongside the output, with the same extension,
+  // which is only moved into place once complete
+  inline fs::path PartialPath(const string& output)
+  {
+    fs::path outputPath(output);
+    return outputPath.parent_path() / ( ".partial_" + outputPath.filename().string() );
+  }
+
+  // unlike readImage, throws rather than exiting on failure
+  template <typename ImageType>
+  typename ImageType::Pointer Read(const string& input)
+  {
+    typedef itk::ImageFileReader< ImageType > ReaderType;
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( input );
+    reader->Update();
+
+    typename ImageType::Pointer image = reader->GetOutput();
+    image->DisconnectPipeline();
+    return image;
+  }
+
+  // unlike writeImage, throws rather than exiting on failure,
+  // and writes on the calling thread only, as images are already processed in parallel
+  template <typename ImageType>
+  void Write(const ImageType *image, const string& output)
+  {
+    if( output.empty() ) throw std::runtime_error("no output path given");
+    const fs::path partialPath = PartialPath(output);
+
+    typedef itk::ImageFileWriter< ImageType > WriterType;
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetInput( image );
+    writer->SetFileName( partialPath.string() );
+    writer->SetUseCompression( true );
+
+    try {
+      writer->Update();
+      fs::rename( partialPath, output );
+    }
+    catch( ... ) {
+      boost::system::error_code error;
+      fs::remove( partialPath, error );
+      throw;
+    }
+  }
+
+  // Calls operation(input, output) for each image, which returns whether it succeeded
+  // or throws. The output is empty for operations that only read.
+  template <typename OperationType>
+  struct ProcessImages {
+    OperationType& operation;
+    const vector< string > &inputs, &outputs;
+    bool force;
+    vector< string > statuses;
+    itk::SimpleFastMutexLock outputLock;
+
+    ProcessImages(OperationType& op, const vector< string >& i, const vector< string >& o, bool f):
+    operation(op), inputs(i), outputs(o), force(f), statuses(i.size()) {}
+
+    void operator()(unsigned int i)
+    {
+      string status = "skipped";
+      if( force || outputs[i].empty() || !UpToDate(inputs[i], outputs[i]) )
+      {
+        status = "failed";
+        try {
+          if( operation(inputs[i], outputs[i]) ) status = "ok";
+        }
+        catch( itk::ExceptionObject & excep ) {
+          outputLock.Lock();
+          cerr << "Exception caught while processing " << inputs[i] << "!" << endl;
+          cerr << excep << endl;
+          outputLock.Unlock();
+        }
+        catch( std::exception & e ) {
+          outputLock.Lock();
+          cerr << "Error while processing " << inputs[i] << ": " << e.what() << endl;
+          outputLock.Unlock();
+        }
+      }
+
+      outputLock.Lock();
+      statuses[i] = status;
+      cout << status << "\t" << inputs[i] << "\t" << outputs[i] << endl;
+      outputLock.Unlock();
+    }
+  };
+
+  // processes the images and prints a summary, returning whether none failed
+  template <typename OperationType>
+  bool Process(OperationType& operation, const vector< string >& inputs, const vector< string >& outputs,
+               unsigned int numberOfThreads = 0, bool force = false)
+  {
+    // register the image IO factories before any threads need them
+    if( !inputs.empty() ) itk::ImageIOFactory::CreateImageIO( inputs[0].c_str(), itk::ImageIOFactory::ReadMode );
+
+    itk::TimeProbe clock;
+    clock.Start();
+    ProcessImages< OperationType > processImages(operation, inputs, outputs, force);
+    parallelFor(inputs.size(), processImages, numberOfThreads);
+    clock.Stop();
+
+    unsigned int ok = 0, skipped = 0, failed = 0;
+    double megabytes = 0;
+    for(unsigned int i=0; i<inputs.size(); ++i)
+    {
+      const string& status = processImages.statuses[i];
+      if( status == "ok" )
+      {
+        ++ok;
+        boost::system::error_code error;
+        const boost::uintmax_t size = fs::file_size(inputs[i], error);
+        if( !error ) megabytes += size / 1e6;
+      }
+      if( status == "skipped" ) ++skipped;
+      if( status == "failed" ) ++failed;
+    }
+
+    const double seconds = clock.GetTotal();
+    cerr << ok << " processed, " << skipped << " skipped and " << failed << " failed in " << seconds << "s";
+    if( ok && seconds > 0 ) cerr << ", " << ok / seconds << " images/s, " << megabytes / seconds << "MB/s of input";
+    cerr << endl;
+    for(unsigned int i=0; i<inputs.size(); ++i)
+    {
+      if( processImages.statuses[i] == "failed" ) cerr << "failed: " << inputs[i] << endl;
+    }
+
+    return failed == 0;
+  }
+}
+
+#endif
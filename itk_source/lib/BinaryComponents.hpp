@@ -0,0 +1,285 @@
+// Labels the connected components of the foreground of a binary volume, and removes
+// components by size, as BinaryShapeOpeningImageFilter and BinaryShapeKeepNObjectsImageFilter
+// do with the NumberOfPixels or PhysicalSize attributes, without building a label map
+// or computing any other attribute. The foreground is run-length encoded row by row,
+// then runs touching each other are joined with union-find, in parallel over blocks
+// of planes and then across the blocks' seams, so memory is a few words per run
+// rather than per pixel. Removed components are cleared in place.
+
+#ifndef BINARYCOMPONENTS_HPP_
+#define BINARYCOMPONENTS_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include "itkImage.h"
+
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace BinaryComponents {
+  typedef itk::Image< unsigned char, 3 > ImageType;
+
+  // foreground pixels [begin, end) of a row
+  struct Run {
+    uint32_t begin, end;
+  };
+
+  struct RunLengths {
+    unsigned long width, height, depth;
+    // the runs of row y + z * height are runs[rowStarts[row]] to runs[rowStarts[row + 1]]
+    vector< unsigned long > rowStarts;
+    vector< Run > runs;
+  };
+
+  // counts the runs of each row of plane z, or then fills them in
+  struct EncodePlanes {
+    const unsigned char *buffer;
+    unsigned char foreground;
+    RunLengths *runLengths;
+    bool fill;
+
+    void operator()(unsigned int z)
+    {
+      const unsigned long width = runLengths->width;
+      for(unsigned long y=0; y<runLengths->height; ++y)
+      {
+        const unsigned long row = y + z * runLengths->height;
+        const unsigned char *pixels = buffer + row * width;
+        Run *runs = fill ? &runLengths->runs[0] + runLengths->rowStarts[row] : 0;
+        unsigned long n = 0;
+        for(unsigned long x=0; x<width; )
+        {
+          if( pixels[x] != foreground )
+          {
+            ++x;
+            continue;
+          }
+          const unsigned long begin = x;
+          while( x < width && pixels[x] == foreground ) ++x;
+          if( fill )
+          {
+            runs[n].begin = begin;
+            runs[n].end = x;
+          }
+          ++n;
+        }
+        // counts go one row on, so that summing them gives each row's start
+        if( !fill ) runLengths->rowStarts[row + 1] = n;
+      }
+    }
+  };
+
+  inline void Encode(const unsigned char *buffer, const ImageType::SizeType& size, unsigned char foreground,
+                     RunLengths& runLengths, unsigned int numberOfThreads = 0)
+  {
+    runLengths.width = size[0];
+    runLengths.height = size[1];
+    runLengths.depth = size[2];
+    runLengths.rowStarts.assign( size[1] * size[2] + 1, 0 );
+
+    EncodePlanes encodePlanes;
+    encodePlanes.buffer = buffer;
+    encodePlanes.foreground = foreground;
+    encodePlanes.runLengths = &runLengths;
+    encodePlanes.fill = false;
+    parallelFor(size[2], encodePlanes, numberOfThreads);
+
+    for(unsigned long row=0; row+1<runLengths.rowStarts.size(); ++row) runLengths.rowStarts[row + 1] += runLengths.rowStarts[row];
+    runLengths.runs.resize( runLengths.rowStarts.back() );
+
+    encodePlanes.fill = true;
+    parallelFor(size[2], encodePlanes, numberOfThreads);
+  }
+
+  // Union-find over runs, always linking to the smaller root, so that every run's
+  // parent is at or before it
+  inline unsigned long Find(vector< unsigned long >& parents, unsigned long i)
+  {
+    while( parents[i] != i )
+    {
+      parents[i] = parents[ parents[i] ];
+      i = parents[i];
+    }
+    return i;
+  }
+
+  inline void Union(vector< unsigned long >& parents, unsigned long a, unsigned long b)
+  {
+    a = Find(parents, a);
+    b = Find(parents, b);
+    if( a < b ) parents[b] = a;
+    if( b < a ) parents[a] = b;
+  }
+
+  // joins the runs of two rows that touch, diagonally too if fully connected
+  inline void ConnectRows(const RunLengths& runLengths, vector< unsigned long >& parents,
+                          unsigned long rowA, unsigned long rowB, bool fullyConnected)
+  {
+    unsigned long a = runLengths.rowStarts[rowA], b = runLengths.rowStarts[rowB];
+    const unsigned long aEnd = runLengths.rowStarts[rowA + 1], bEnd = runLengths.rowStarts[rowB + 1];
+    const uint32_t slack = fullyConnected ? 1 : 0;
+    while( a < aEnd && b < bEnd )
+    {
+      const Run &runA = runLengths.runs[a], &runB = runLengths.runs[b];
+      if( runA.begin < runB.end + slack && runB.begin < runA.end + slack ) Union(parents, a, b);
+      if( runA.end < runB.end ) ++a;
+      else ++b;
+    }
+  }
+
+  // joins row y of plane z to its neighbours in the row before, and in the plane before
+  inline void ConnectRow(const RunLengths& runLengths, vector< unsigned long >& parents,
+                         unsigned long y, unsigned long z, bool samePlane, bool planeBefore, bool fullyConnected)
+  {
+    const unsigned long height = runLengths.height, row = y + z * height;
+    if( samePlane && y > 0 ) ConnectRows(runLengths, parents, row, row - 1, fullyConnected);
+    if( !planeBefore || z == 0 ) return;
+
+    ConnectRows(runLengths, parents, row, row - height, fullyConnected);
+    if( fullyConnected )
+    {
+      if( y > 0 ) ConnectRows(runLengths, parents, row, row - height - 1, true);
+      if( y + 1 < height ) ConnectRows(runLengths, parents, row, row - height + 1, true);
+    }
+  }
+
+  // joins the runs within each block of planes, whose runs no other block touches
+  struct ConnectBlocks {
+    const RunLengths *runLengths;
+    vector< unsigned long > *parents;
+    bool fullyConnected;
+    unsigned int numberOfBlocks;
+
+    unsigned long FirstPlane(unsigned int block) const
+    {
+      return runLengths->depth * block / numberOfBlocks;
+    }
+
+    void operator()(unsigned int block)
+    {
+      const unsigned long first = FirstPlane(block), end = FirstPlane(block + 1);
+      for(unsigned long z=first; z<end; ++z)
+        for(unsigned long y=0; y<runLengths->height; ++y)
+          ConnectRow(*runLengths, *parents, y, z, true, z > first, fullyConnected);
+    }
+  };
+
+  // Labels the runs' connected components 0, 1, ... in the order of their first runs,
+  // returning each run's label, and each component's number of pixels
+  inline void Label(const RunLengths& runLengths, bool fullyConnected, vector< unsigned long >& labels,
+                    vector< unsigned long >& sizes, unsigned int numberOfThreads = 0)
+  {
+    const unsigned long n = runLengths.runs.size();
+    labels.resize(n);
+    for(unsigned long i=0; i<n; ++i) labels[i] = i;
+
+    if( numberOfThreads == 0 ) numberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+    ConnectBlocks connectBlocks;
+    connectBlocks.runLengths = &runLengths;
+    connectBlocks.parents = &labels;
+    connectBlocks.fullyConnected = fullyConnected;
+    connectBlocks.numberOfBlocks = max< unsigned long >( 1, min< unsigned long >( numberOfThreads, runLengths.depth ) );
+    parallelFor(connectBlocks.numberOfBlocks, connectBlocks, numberOfThreads);
+
+    // the seams between blocks
+    for(unsigned int block=1; block<connectBlocks.numberOfBlocks; ++block)
+    {
+      const unsigned long z = connectBlocks.FirstPlane(block);
+      for(unsigned long y=0; y<runLengths.height; ++y) ConnectRow(runLengths, labels, y, z, false, true, fullyConnected);
+    }
+
+    // Parents come first, so are already labels when their children are reached
+    sizes.clear();
+    for(unsigned long i=0; i<n; ++i)
+    {
+      if( labels[i] == i )
+      {
+        labels[i] = sizes.size();
+        sizes.push_back(0);
+      }
+      else
+      {
+        labels[i] = labels[ labels[i] ];
+      }
+      sizes[ labels[i] ] += runLengths.runs[i].end - runLengths.runs[i].begin;
+    }
+  }
+
+  // which components to keep: those of at least lambda, or at most if reversed,
+  // as ShapeOpeningLabelMapFilter
+  inline vector< bool > KeepBySize(const vector< unsigned long >& sizes, double pixelSize, double lambda, bool reverseOrdering)
+  {
+    vector< bool > keep( sizes.size() );
+    for(unsigned long label=0; label<sizes.size(); ++label)
+    {
+      const double size = sizes[label] * pixelSize;
+      keep[label] = reverseOrdering ? size <= lambda : size >= lambda;
+    }
+    return keep;
+  }
+
+  struct SizeOrder {
+    const vector< unsigned long > *sizes;
+    bool reverseOrdering;
+    bool operator()(unsigned long a, unsigned long b) const
+    {
+      return reverseOrdering ? (*sizes)[a] < (*sizes)[b] : (*sizes)[a] > (*sizes)[b];
+    }
+  };
+
+  // the number largest components, or smallest if reversed, ties going to the first
+  inline vector< bool > KeepLargest(const vector< unsigned long >& sizes, unsigned long number, bool reverseOrdering)
+  {
+    vector< unsigned long > order( sizes.size() );
+    for(unsigned long label=0; label<order.size(); ++label) order[label] = label;
+    SizeOrder sizeOrder;
+    sizeOrder.sizes = &sizes;
+    sizeOrder.reverseOrdering = reverseOrdering;
+    stable_sort(order.begin(), order.end(), sizeOrder);
+
+    vector< bool > keep( sizes.size(), false );
+    for(unsigned long i=0; i<min< unsigned long >( number, order.size() ); ++i) keep[ order[i] ] = true;
+    return keep;
+  }
+
+  // sets the runs of components not kept to background, a plane at a time
+  struct ClearPlanes {
+    unsigned char *buffer;
+    const RunLengths *runLengths;
+    const vector< unsigned long > *labels;
+    const vector< bool > *keep;
+    unsigned char background;
+
+    void operator()(unsigned int z)
+    {
+      for(unsigned long y=0; y<runLengths->height; ++y)
+      {
+        const unsigned long row = y + z * runLengths->height;
+        unsigned char *pixels = buffer + row * runLengths->width;
+        for(unsigned long i=runLengths->rowStarts[row]; i<runLengths->rowStarts[row + 1]; ++i)
+        {
+          if( (*keep)[ (*labels)[i] ] ) continue;
+          const Run& run = runLengths->runs[i];
+          fill(pixels + run.begin, pixels + run.end, background);
+        }
+      }
+    }
+  };
+
+  inline void Clear(unsigned char *buffer, const RunLengths& runLengths, const vector< unsigned long >& labels,
+                    const vector< bool >& keep, unsigned char background, unsigned int numberOfThreads = 0)
+  {
+    ClearPlanes clearPlanes;
+    clearPlanes.buffer = buffer;
+    clearPlanes.runLengths = &runLengths;
+    clearPlanes.labels = &labels;
+    clearPlanes.keep = &keep;
+    clearPlanes.background = background;
+    parallelFor(runLengths.depth, clearPlanes, numberOfThreads);
+  }
+}
+
+#endif
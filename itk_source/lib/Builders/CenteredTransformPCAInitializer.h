@@ -3,7 +3,8 @@
 
 #include "itkObject.h"
 #include "itkObjectFactory.h"
-#include "itkImageMomentsCalculator.h"
+
+#include "SliceMoments.hpp"
 
 #include <iostream>
 
@@ -16,6 +17,10 @@ namespace itk
  *
  * This class is connected to the fixed image, moving image and transform
  * involved in the registration.
+ *
+ * Moments are computed with computeSliceMoments(), so both images must be 2D.
+ * If the fixed image's moments are already known, they can be supplied with
+ * SetFixedMoments() to avoid recomputing them.
  * 
  */
 template< class TTransform,
@@ -53,15 +58,6 @@ public:
   typedef   typename FixedImageType::ConstPointer  FixedImagePointer;
   typedef   typename MovingImageType::ConstPointer MovingImagePointer;
 
-  /** Moment calculators */
-  typedef ImageMomentsCalculator< FixedImageType >  FixedImageCalculatorType;
-  typedef ImageMomentsCalculator< MovingImageType > MovingImageCalculatorType;
-
-  typedef typename FixedImageCalculatorType::Pointer
-  FixedImageCalculatorPointer;
-  typedef typename MovingImageCalculatorType::Pointer
-  MovingImageCalculatorPointer;
-
   /** Offset type. */
   typedef typename TransformType::OffsetType OffsetType;
 
@@ -83,12 +79,21 @@ public:
   /** Set the moving image used in the registration process */
   itkSetConstObjectMacro(MovingImage, MovingImageType);
 
+  /** Supply precomputed fixed image moments, which are then used
+   * in place of the fixed image's own */
+  void SetFixedMoments(const SliceMoments & moments)
+    {
+    m_FixedMoments = moments;
+    m_UseFixedMoments = true;
+    this->Modified();
+    }
+
   /** Initialize the transform using data from the images */
   virtual void InitializeTransform();
 
-  /** Get() access to the moments calculators */
-  itkGetConstObjectMacro(FixedCalculator,  FixedImageCalculatorType);
-  itkGetConstObjectMacro(MovingCalculator, MovingImageCalculatorType);
+  /** Get() access to the moments */
+  const SliceMoments & GetFixedMoments() const { return m_FixedMoments; }
+  const SliceMoments & GetMovingMoments() const { return m_MovingMoments; }
 protected:
   CenteredTransformPCAInitializer();
   ~CenteredTransformPCAInitializer(){}
@@ -106,8 +111,10 @@ private:
 
   MovingImagePointer m_MovingImage;
 
-  FixedImageCalculatorPointer  m_FixedCalculator;
-  MovingImageCalculatorPointer m_MovingCalculator;
+  SliceMoments m_FixedMoments;
+  SliceMoments m_MovingMoments;
+
+  bool m_UseFixedMoments;
 }; //class CenteredTransformPCAInitializer
 }  // namespace registration
 
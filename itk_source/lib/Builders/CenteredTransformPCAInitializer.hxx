@@ -9,8 +9,7 @@ template< class TTransform, class TFixedImage, class TMovingImage >
 CenteredTransformPCAInitializer< TTransform, TFixedImage, TMovingImage >
 ::CenteredTransformPCAInitializer()
 {
-  m_FixedCalculator  = FixedImageCalculatorType::New();
-  m_MovingCalculator = MovingImageCalculatorType::New();
+  m_UseFixedMoments = false;
 }
 
 template< class TTransform, class TFixedImage, class TMovingImage >
@@ -19,7 +18,7 @@ CenteredTransformPCAInitializer< TTransform, TFixedImage, TMovingImage >
 ::InitializeTransform()
 {
   // Sanity check
-  if ( !m_FixedImage )
+  if ( !m_FixedImage && !m_UseFixedMoments )
     {
     itkExceptionMacro("Fixed Image has not been set");
     return;
@@ -36,7 +35,7 @@ CenteredTransformPCAInitializer< TTransform, TFixedImage, TMovingImage >
     }
 
   // If images come from filters, then update those filters.
-  if ( m_FixedImage->GetSource() )
+  if ( !m_UseFixedMoments && m_FixedImage->GetSource() )
     {
     m_FixedImage->GetSource()->Update();
     }
@@ -49,17 +48,15 @@ CenteredTransformPCAInitializer< TTransform, TFixedImage, TMovingImage >
   OutputVectorType translationVector;
   ScalarType       angle;
 
-  m_FixedCalculator->SetImage(m_FixedImage);
-  m_FixedCalculator->Compute();
-  m_MovingCalculator->SetImage(m_MovingImage);
-  m_MovingCalculator->Compute();
+  if ( !m_UseFixedMoments )
+    {
+    m_FixedMoments = computeSliceMoments(m_FixedImage.GetPointer());
+    }
+  m_MovingMoments = computeSliceMoments(m_MovingImage.GetPointer());
   
   // calculate centre of rotation and translation
-  typename FixedImageCalculatorType::VectorType fixedCenter =
-    m_FixedCalculator->GetCenterOfGravity();
-
-  typename MovingImageCalculatorType::VectorType movingCenter =
-    m_MovingCalculator->GetCenterOfGravity();
+  const SliceMoments::VectorType & fixedCenter  = m_FixedMoments.CenterOfGravity;
+  const SliceMoments::VectorType & movingCenter = m_MovingMoments.CenterOfGravity;
   
   for ( unsigned int i = 0; i < InputSpaceDimension; i++ )
     {
@@ -70,8 +67,8 @@ CenteredTransformPCAInitializer< TTransform, TFixedImage, TMovingImage >
   // calculate transform angle
   // moving angle - fixed angle, -π/2 < angle ≤ π/2
   vnl_matrix< double > rotationMatrix =
-    m_FixedCalculator->GetPrincipalAxes().GetTranspose()
-    * m_MovingCalculator->GetPrincipalAxes().GetVnlMatrix();
+    m_FixedMoments.PrincipalAxes.GetTranspose()
+    * m_MovingMoments.PrincipalAxes.GetVnlMatrix();
   angle = asin( rotationMatrix.get(0,1) );
   
   // initialise transform
@@ -117,25 +114,11 @@ CenteredTransformPCAInitializer< TTransform, TFixedImage, TMovingImage >
     os << indent << "None" << std::endl;
     }
 
-  os << indent << "MovingMomentCalculator   = " << std::endl;
-  if ( m_MovingCalculator )
-    {
-    os << indent << m_MovingCalculator  << std::endl;
-    }
-  else
-    {
-    os << indent << "None" << std::endl;
-    }
-
-  os << indent << "FixedMomentCalculator   = " << std::endl;
-  if ( m_FixedCalculator )
-    {
-    os << indent << m_FixedCalculator  << std::endl;
-    }
-  else
-    {
-    os << indent << "None" << std::endl;
-    }
+  os << indent << "FixedCenterOfGravity   = "
+     << m_FixedMoments.CenterOfGravity << std::endl;
+  os << indent << "MovingCenterOfGravity   = "
+     << m_MovingMoments.CenterOfGravity << std::endl;
+  os << indent << "UseFixedMoments   = " << m_UseFixedMoments << std::endl;
 }
 }  // namespace registration
 
@@ -0,0 +1,278 @@
+// Displacement statistics between transforms, over the non-zero pixels of a mask.
+// Linear transforms are inverted once and reduced to 2x3 affine matrices,
+// so that the displacement of every mask pixel is a single affine map of its index,
+// evaluated over a compacted list of mask pixel coordinates.
+
+#ifndef GROUNDTRUTHERROR_HPP_
+#define GROUNDTRUTHERROR_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "itkTransform.h"
+#include "itkImage.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace GroundTruthError {
+  typedef itk::Transform< double, 2, 2 > TransformType;
+  typedef itk::Image< unsigned char, 2 > MaskType;
+
+  // x' = m[0]x + m[1]y + m[2]
+  // y' = m[3]x + m[4]y + m[5]
+  struct Affine2D {
+    double m[6];
+
+    // this, followed by other
+    Affine2D Then(const Affine2D& other) const
+    {
+      const double *o = other.m;
+      Affine2D c = { {
+        o[0] * m[0] + o[1] * m[3], o[0] * m[1] + o[1] * m[4], o[0] * m[2] + o[1] * m[5] + o[2],
+        o[3] * m[0] + o[4] * m[3], o[3] * m[1] + o[4] * m[4], o[3] * m[2] + o[4] * m[5] + o[5]
+      } };
+      return c;
+    }
+
+    Affine2D operator-(const Affine2D& other) const
+    {
+      Affine2D d;
+      for(unsigned int i=0; i<6; ++i) d.m[i] = m[i] - other.m[i];
+      return d;
+    }
+  };
+
+  // recover the affine matrix of a linear transform from the images of three points
+  Affine2D ToAffine(const TransformType *transform)
+  {
+    if( !transform->IsLinear() )
+    {
+      cerr << "Ground truth errors can only be calculated for linear transforms, not a " << transform->GetNameOfClass() << endl;
+      exit(EXIT_FAILURE);
+    }
+
+    TransformType::InputPointType origin, x, y;
+    origin[0] = 0; origin[1] = 0;
+    x[0] = 1; x[1] = 0;
+    y[0] = 0; y[1] = 1;
+
+    const TransformType::OutputPointType t0 = transform->TransformPoint(origin);
+    const TransformType::OutputPointType tx = transform->TransformPoint(x);
+    const TransformType::OutputPointType ty = transform->TransformPoint(y);
+
+    Affine2D a = { {
+      tx[0] - t0[0], ty[0] - t0[0], t0[0],
+      tx[1] - t0[1], ty[1] - t0[1], t0[1]
+    } };
+    return a;
+  }
+
+  Affine2D InverseToAffine(const TransformType *transform)
+  {
+    TransformType::InverseTransformBasePointer inverse = transform->GetInverseTransform();
+    if( !inverse )
+    {
+      cerr << "Couldn't invert " << transform->GetNameOfClass() << endl;
+      exit(EXIT_FAILURE);
+    }
+    return ToAffine( inverse.GetPointer() );
+  }
+
+  // index coordinates of the non-zero pixels of a mask,
+  // along with the affine map from index to physical space
+  class MaskPoints {
+  public:
+    MaskPoints(const MaskType *mask)
+    {
+      typedef itk::ImageRegionConstIteratorWithIndex< MaskType > ConstIteratorType;
+      for(ConstIteratorType it(mask, mask->GetLargestPossibleRegion()); !it.IsAtEnd(); ++it)
+      {
+        if(it.Get())
+        {
+          m_x.push_back(it.GetIndex()[0]);
+          m_y.push_back(it.GetIndex()[1]);
+        }
+      }
+
+      // p = origin + D.S.i
+      for(unsigned int r=0; r<2; ++r)
+      {
+        for(unsigned int c=0; c<2; ++c)
+        {
+          m_indexToPhysical.m[3*r + c] = mask->GetDirection()[r][c] * mask->GetSpacing()[c];
+        }
+        m_indexToPhysical.m[3*r + 2] = mask->GetOrigin()[r];
+      }
+    }
+
+    unsigned int GetSize() const { return m_x.size(); }
+    const float * GetX() const { return &m_x[0]; }
+    const float * GetY() const { return &m_y[0]; }
+    const Affine2D& GetIndexToPhysical() const { return m_indexToPhysical; }
+
+  private:
+    vector< float > m_x, m_y;
+    Affine2D m_indexToPhysical;
+  };
+
+  struct Statistics {
+    unsigned int count;
+    double mean;
+    double max;
+    vector< double > percentiles;
+  };
+
+  // |a(x, y)| for each point
+  inline void displacementMagnitudes(const Affine2D& a, const float *x, const float *y, unsigned int n, double *out)
+  {
+    const double *m = a.m;
+    unsigned int i = 0;
+#ifdef __SSE2__
+    const __m128d m0 = _mm_set1_pd(m[0]), m1 = _mm_set1_pd(m[1]), m2 = _mm_set1_pd(m[2]),
+                  m3 = _mm_set1_pd(m[3]), m4 = _mm_set1_pd(m[4]), m5 = _mm_set1_pd(m[5]);
+    for(; i + 2 <= n; i += 2)
+    {
+      // load 2 floats of each coordinate and widen to double
+      const __m128d xs = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast< const __m128i* >(x + i))));
+      const __m128d ys = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast< const __m128i* >(y + i))));
+      const __m128d dx = _mm_add_pd(_mm_add_pd(_mm_mul_pd(m0, xs), _mm_mul_pd(m1, ys)), m2);
+      const __m128d dy = _mm_add_pd(_mm_add_pd(_mm_mul_pd(m3, xs), _mm_mul_pd(m4, ys)), m5);
+      _mm_storeu_pd(out + i, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy))));
+    }
+#endif
+    for(; i<n; ++i)
+    {
+      const double dx = m[0] * x[i] + m[1] * y[i] + m[2];
+      const double dy = m[3] * x[i] + m[4] * y[i] + m[5];
+      out[i] = sqrt(dx * dx + dy * dy);
+    }
+  }
+
+  // evaluates displacement magnitudes in fixed-size chunks,
+  // keeping a partial sum and maximum for each
+  struct DisplacementChunks {
+    static const unsigned int ChunkSize = 1 << 16;
+
+    const Affine2D& a;
+    const MaskPoints& points;
+    vector< double >& distances;
+    vector< double > sums, maxima;
+
+    DisplacementChunks(const Affine2D& affine, const MaskPoints& p, vector< double >& d):
+    a(affine), points(p), distances(d),
+    sums(GetNumberOfChunks(), 0), maxima(GetNumberOfChunks(), 0) {}
+
+    unsigned int GetNumberOfChunks() const { return (points.GetSize() + ChunkSize - 1) / ChunkSize; }
+
+    void operator()(unsigned int chunk)
+    {
+      const unsigned int begin = chunk * ChunkSize;
+      const unsigned int remaining = points.GetSize() - begin;
+      const unsigned int n = remaining < ChunkSize ? remaining : ChunkSize;
+      displacementMagnitudes(a, points.GetX() + begin, points.GetY() + begin, n, &distances[begin]);
+
+      double sum = 0, maximum = 0;
+      for(unsigned int i=begin; i<begin + n; ++i)
+      {
+        sum += distances[i];
+        maximum = max(maximum, distances[i]);
+      }
+      sums[chunk] = sum;
+      maxima[chunk] = maximum;
+    }
+  };
+
+  // Statistics of the magnitude of the displacement field
+  // that maps each mask pixel's physical position p to displacement(p).
+  // Percentiles are given in the range [0, 100], and use the nearest rank.
+  Statistics DisplacementStatistics(const MaskPoints& points,
+                                    const Affine2D& displacement,
+                                    const vector< double >& percentiles = vector< double >(),
+                                    unsigned int numberOfThreads = 0)
+  {
+    Statistics statistics;
+    statistics.count = points.GetSize();
+    statistics.mean = statistics.max = 0;
+    if(statistics.count == 0)
+    {
+      statistics.percentiles.assign(percentiles.size(), 0);
+      return statistics;
+    }
+
+    // work in index space, so each point costs a single affine map
+    const Affine2D a = points.GetIndexToPhysical().Then(displacement);
+
+    vector< double > distances(points.GetSize());
+    DisplacementChunks chunks(a, points, distances);
+    parallelFor(chunks.GetNumberOfChunks(), chunks, numberOfThreads);
+
+    double sum = 0;
+    for(unsigned int c=0; c<chunks.GetNumberOfChunks(); ++c)
+    {
+      sum += chunks.sums[c];
+      statistics.max = max(statistics.max, chunks.maxima[c]);
+    }
+    statistics.mean = sum / statistics.count;
+
+    for(unsigned int i=0; i<percentiles.size(); ++i)
+    {
+      assert(percentiles[i] >= 0 && percentiles[i] <= 100);
+      unsigned int rank = (unsigned int)ceil(percentiles[i] / 100.0 * distances.size());
+      unsigned int k = rank > 0 ? rank - 1 : 0;
+      nth_element(distances.begin(), distances.begin() + k, distances.end());
+      statistics.percentiles.push_back(distances[k]);
+    }
+
+    return statistics;
+  }
+
+  // distance between each pixel's position under the inverses of transform1 and transform2
+  Statistics AbsoluteError(const MaskPoints& points,
+                           const TransformType *transform1,
+                           const TransformType *transform2,
+                           const vector< double >& percentiles = vector< double >(),
+                           unsigned int numberOfThreads = 0)
+  {
+    const Affine2D displacement = InverseToAffine(transform1) - InverseToAffine(transform2);
+    return DisplacementStatistics(points, displacement, percentiles, numberOfThreads);
+  }
+
+  // distance between each pixel's position mapped from slice 1 to slice 2
+  // by the perfect transforms and by the noisy transforms
+  Statistics RelativeError(const MaskPoints& points,
+                           const TransformType *perfectTransform1,
+                           const TransformType *perfectTransform2,
+                           const TransformType *noisyTransform1,
+                           const TransformType *noisyTransform2,
+                           const vector< double >& percentiles = vector< double >(),
+                           unsigned int numberOfThreads = 0)
+  {
+    const Affine2D perfect = InverseToAffine(perfectTransform1).Then( ToAffine(perfectTransform2) );
+    const Affine2D noisy   = InverseToAffine(noisyTransform1  ).Then( ToAffine(noisyTransform2  ) );
+    return DisplacementStatistics(points, perfect - noisy, percentiles, numberOfThreads);
+  }
+
+  void PrintStatistics(ostream& os, const Statistics& statistics, bool printAll)
+  {
+    os << statistics.mean;
+    if(printAll)
+    {
+      os << " " << statistics.max;
+      for(unsigned int i=0; i<statistics.percentiles.size(); ++i)
+      {
+        os << " " << statistics.percentiles[i];
+      }
+    }
+    os << endl;
+  }
+}
+
+#endif
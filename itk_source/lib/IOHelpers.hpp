@@ -2,15 +2,20 @@
 #define IO_HELPERS_HPP_
 
 #include <sys/stat.h> // for fileExists
+#include <fstream> // for isCompressedMetaImage
 #include "boost/filesystem.hpp"
 
 #include "itkImage.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
+#include "itkImageIOFactory.h"
+#include "itkMetaImageIO.h"
 #include "itkTransformFileReader.h"
 #include "itkTxtTransformIO.h"
 
 #include "PathHelpers.hpp"
+#include "TiledVolume.hpp"
+#include "MetaImageWriter.hpp"
 
 using namespace std;
 typedef itk::TxtTransformIO TransformIOType;
@@ -108,6 +113,8 @@ void writeTransform(const itk::TransformBase *transform, const string& fileName)
 template<typename ImageType>
 typename ImageType::Pointer readImage(const string& fileName)
 {
+  if( TiledVolume::IsTiledVolume(fileName) ) return TiledVolume::Read< ImageType >(fileName);
+  
   typedef itk::ImageFileReader< ImageType > ReaderType;
   typename ReaderType::Pointer reader = ReaderType::New();
 	
@@ -125,6 +132,101 @@ typename ImageType::Pointer readImage(const string& fileName)
   return reader->GetOutput();
 }
 
+// the image's extent and geometry, without reading any pixels
+template<typename ImageType>
+typename ImageType::Pointer readImageInformation(const string& fileName)
+{
+  if( TiledVolume::IsTiledVolume(fileName) ) return TiledVolume::ReadInformation< ImageType >(fileName);
+  
+  typedef itk::ImageFileReader< ImageType > ReaderType;
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( fileName.c_str() );
+  
+  try {
+    reader->UpdateOutputInformation();
+  }
+  catch( itk::ExceptionObject & err ) {
+    cerr << "ExceptionObject caught while reading image information." << endl;
+    cerr << err << endl;
+    exit(EXIT_FAILURE);
+  }
+  
+  typename ImageType::Pointer image = reader->GetOutput();
+  image->DisconnectPipeline();
+  return image;
+}
+
+// whether the header of a MetaImage says its pixel data is compressed
+inline bool isCompressedMetaImage(const string& fileName)
+{
+  ifstream file(fileName.c_str());
+  string line;
+  while( getline(file, line) )
+  {
+    const string::size_type equals = line.find('=');
+    if( equals == string::npos ) continue;
+    
+    string key = line.substr(0, equals);
+    key.erase(key.find_last_not_of(" \t\r") + 1);
+    const string::size_type value = line.find_first_not_of(" \t", equals + 1);
+    
+    // read as MetaIO reads booleans
+    if( key == "CompressedData" ) return value != string::npos && ( line[value] == 'T' || line[value] == 't' || line[value] == '1' );
+    // the last line of the header
+    if( key == "ElementDataFile" ) break;
+  }
+  return false;
+}
+
+// Whether regions of the file can be read without reading all of it.
+// ITK streams compressed MetaImages too, but inflates the data from its start
+// for each region, so reading one slab at a time would cost far more than reading
+// it whole once.
+inline bool canStreamRead(const string& fileName)
+{
+  if( TiledVolume::IsTiledVolume(fileName) ) return true;
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO( fileName.c_str(), itk::ImageIOFactory::ReadMode );
+  if( !imageIO || !imageIO->CanStreamRead() ) return false;
+  return !( dynamic_cast< itk::MetaImageIO* >( imageIO.GetPointer() ) && isCompressedMetaImage(fileName) );
+}
+
+// Reads region of an image, and as little else as its format allows:
+// just the tiles that intersect it for tiled volumes, just the region itself
+// for formats ITK can stream, such as uncompressed MetaImage, or the whole image
+// otherwise. Callers reading many regions should check canStreamRead first.
+// The returned image's buffered region contains region.
+template<typename ImageType>
+typename ImageType::Pointer readImageRegion(const string& fileName, const typename ImageType::RegionType& region, unsigned int numberOfThreads = 0)
+{
+  if( TiledVolume::IsTiledVolume(fileName) ) return TiledVolume::ReadRegion< ImageType >(fileName, region, numberOfThreads);
+  
+  typedef itk::ImageFileReader< ImageType > ReaderType;
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( fileName.c_str() );
+  
+  try {
+    reader->UpdateOutputInformation();
+    
+    typename ImageType::Pointer image = reader->GetOutput();
+    if( !image->GetLargestPossibleRegion().IsInside(region) )
+    {
+      cerr << "Region " << region << " is outside " << fileName << "." << endl;
+      exit(EXIT_FAILURE);
+    }
+    
+    // the reader only reads the requested region if its ImageIO can stream
+    image->SetRequestedRegion(region);
+    image->Update();
+    image->DisconnectPipeline();
+    return image;
+  }
+  catch( itk::ExceptionObject & err ) {
+    cerr << "ExceptionObject caught while reading image region." << endl;
+    cerr << err << endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
 template <typename ImageType>
 vector< typename ImageType::Pointer > readImages(vector< string > fileNames)
 {
@@ -147,14 +249,39 @@ vector< typename ImageType::Pointer > readImages(vector< string > fileNames)
 }
 
 // Const Image
+// compressionLevel is zlib's: 0 for none, e.g. for scratch outputs,
+// 1 fastest to 9 smallest, or -1 for its default.
+// MetaImages are compressed in parallel.
 template<typename ImageType>
-void writeImage(const typename ImageType::ConstPointer image, const string& fileName)
+void writeImage(const typename ImageType::ConstPointer image, const string& fileName, int compressionLevel = Z_DEFAULT_COMPRESSION)
 {
+  // bring filter outputs up to date, as ImageFileWriter would
+  try {
+    const_cast< ImageType* >( image.GetPointer() )->Update();
+  }
+  catch( itk::ExceptionObject & err ) {
+    cerr << "ExceptionObject caught while updating " << fileName << " for writing." << endl;
+    cerr << err << endl;
+    exit(EXIT_FAILURE);
+  }
+  
+  if( TiledVolume::IsTiledVolume(fileName) )
+  {
+    TiledVolume::Write< ImageType >(image.GetPointer(), fileName, 64, compressionLevel);
+    return;
+  }
+  
+  if( MetaImageWriter::CanWrite< ImageType >(image.GetPointer(), fileName) )
+  {
+    MetaImageWriter::Write< ImageType >(image.GetPointer(), fileName, compressionLevel);
+    return;
+  }
+  
   typedef itk::ImageFileWriter< ImageType > WriterType;
   typename WriterType::Pointer writer = WriterType::New();
 	
 	writer->SetInput( image );
-  writer->UseCompressionOn();
+  writer->SetUseCompression( compressionLevel != 0 );
   
   writer->SetFileName( fileName.c_str() );
 	
@@ -170,9 +297,9 @@ void writeImage(const typename ImageType::ConstPointer image, const string& file
 
 // Image
 template<typename ImageType>
-void writeImage(const typename ImageType::Pointer image, const string& fileName)
+void writeImage(const typename ImageType::Pointer image, const string& fileName, int compressionLevel = Z_DEFAULT_COMPRESSION)
 {
-  writeImage< ImageType >( (typename ImageType::ConstPointer) image, fileName);
+  writeImage< ImageType >( (typename ImageType::ConstPointer) image, fileName, compressionLevel);
 }
 
 #endif
@@ -0,0 +1,151 @@
+// Single-pass computation of the zeroth, first and second moments of a 2D slice.
+// Produces the same centre of gravity and principal axes as
+// itk::ImageMomentsCalculator, but accumulates in index space one row at a time,
+// mapping to physical space once at the end instead of for every pixel.
+
+#ifndef SLICEMOMENTS_HPP_
+#define SLICEMOMENTS_HPP_
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "itkImage.h"
+#include "itkVector.h"
+#include "itkMatrix.h"
+#include "itkMacro.h"
+#include "vnl/algo/vnl_symmetric_eigensystem.h"
+#include "vnl/vnl_det.h"
+
+struct SliceMoments {
+  typedef itk::Vector< double, 2 > VectorType;
+  typedef itk::Matrix< double, 2, 2 > MatrixType;
+
+  double TotalMass;
+  VectorType CenterOfGravity;
+  MatrixType CentralMoments;
+  VectorType PrincipalMoments;
+  MatrixType PrincipalAxes;
+};
+
+// accumulate sum(v), sum(v*x) and sum(v*x^2) along one row
+template <typename TPixel>
+inline void accumulateMomentsRow(const TPixel *row, unsigned long length, double x0, double sums[3])
+{
+  double s0 = 0, s1 = 0, s2 = 0;
+  for(unsigned long i=0; i<length; ++i)
+  {
+    const double v = row[i], x = x0 + i;
+    s0 += v;
+    s1 += v * x;
+    s2 += v * x * x;
+  }
+  sums[0] += s0;
+  sums[1] += s1;
+  sums[2] += s2;
+}
+
+// float slices are the common case, so vectorise them
+inline void accumulateMomentsRow(const float *row, unsigned long length, double x0, double sums[3])
+{
+  unsigned long i = 0;
+#ifdef __SSE2__
+  __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd(), s2 = _mm_setzero_pd();
+  __m128d xlo = _mm_set_pd(x0 + 1, x0), xhi = _mm_set_pd(x0 + 3, x0 + 2);
+  const __m128d step = _mm_set1_pd(4.0);
+
+  for(; i + 4 <= length; i += 4)
+  {
+    const __m128 v = _mm_loadu_ps(row + i);
+    const __m128d vlo = _mm_cvtps_pd(v);
+    const __m128d vhi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+    const __m128d vxlo = _mm_mul_pd(vlo, xlo);
+    const __m128d vxhi = _mm_mul_pd(vhi, xhi);
+
+    s0 = _mm_add_pd(s0, _mm_add_pd(vlo, vhi));
+    s1 = _mm_add_pd(s1, _mm_add_pd(vxlo, vxhi));
+    s2 = _mm_add_pd(s2, _mm_add_pd(_mm_mul_pd(vxlo, xlo), _mm_mul_pd(vxhi, xhi)));
+
+    xlo = _mm_add_pd(xlo, step);
+    xhi = _mm_add_pd(xhi, step);
+  }
+
+  // horizontal sums
+  double lanes[2];
+  _mm_storeu_pd(lanes, s0); sums[0] += lanes[0] + lanes[1];
+  _mm_storeu_pd(lanes, s1); sums[1] += lanes[0] + lanes[1];
+  _mm_storeu_pd(lanes, s2); sums[2] += lanes[0] + lanes[1];
+#endif
+
+  // remainder
+  accumulateMomentsRow< float >(row + i, length - i, x0 + i, sums);
+}
+
+template <typename SliceType>
+SliceMoments computeSliceMoments(const SliceType *slice)
+{
+  typedef typename SliceType::PixelType PixelType;
+
+  const typename SliceType::RegionType region = slice->GetBufferedRegion();
+  const unsigned long width = region.GetSize(0), height = region.GetSize(1);
+  const double x0 = region.GetIndex(0), y0 = region.GetIndex(1);
+  const PixelType *buffer = slice->GetBufferPointer();
+
+  // raw index-space moments: m, mx, my, mxx, mxy, myy
+  double m = 0, mx = 0, my = 0, mxx = 0, mxy = 0, myy = 0;
+
+  for(unsigned long j=0; j<height; ++j)
+  {
+    double sums[3] = { 0, 0, 0 };
+    accumulateMomentsRow(buffer + j * width, width, x0, sums);
+
+    const double y = y0 + j;
+    m   += sums[0];
+    mx  += sums[1];
+    my  += sums[0] * y;
+    mxx += sums[2];
+    mxy += sums[1] * y;
+    myy += sums[0] * y * y;
+  }
+
+  if( m == 0.0 )
+  {
+    itkGenericExceptionMacro(<< "computeSliceMoments(): Total Mass of the image was zero. "
+                             << "Aborting here to prevent division by zero later on.");
+  }
+
+  // central moments in index space
+  const double cx = mx / m, cy = my / m;
+  vnl_matrix_fixed< double, 2, 2 > indexCentral;
+  indexCentral(0,0) = mxx / m - cx * cx;
+  indexCentral(0,1) = indexCentral(1,0) = mxy / m - cx * cy;
+  indexCentral(1,1) = myy / m - cy * cy;
+
+  // map to physical space, p = origin + D.S.i
+  vnl_matrix_fixed< double, 2, 2 > A = slice->GetDirection().GetVnlMatrix();
+  for(unsigned int c=0; c<2; ++c)
+  {
+    for(unsigned int r=0; r<2; ++r) A(r,c) *= slice->GetSpacing()[c];
+  }
+
+  SliceMoments moments;
+  moments.TotalMass = m;
+  for(unsigned int r=0; r<2; ++r)
+  {
+    moments.CenterOfGravity[r] = slice->GetOrigin()[r] + A(r,0) * cx + A(r,1) * cy;
+  }
+  moments.CentralMoments = A * indexCentral * A.transpose();
+
+  // principal moments and axes, as in itk::ImageMomentsCalculator
+  vnl_symmetric_eigensystem< double > eigen( moments.CentralMoments.GetVnlMatrix().as_matrix() );
+  for(unsigned int i=0; i<2; ++i) moments.PrincipalMoments[i] = eigen.D(i,i);
+  moments.PrincipalAxes = eigen.V.transpose();
+
+  // add a final reflection if needed for a proper rotation
+  const double det = vnl_det( moments.PrincipalAxes.GetVnlMatrix() );
+  for(unsigned int i=0; i<2; ++i) moments.PrincipalAxes[1][i] *= det;
+
+  return moments;
+}
+
+#endif
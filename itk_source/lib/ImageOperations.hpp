@@ -0,0 +1,259 @@
+// Runs a sequence of the single-image preparation steps on an RGB image held in
+// memory, so that an original is read once and only the final result is written,
+// rather than each of ConvertRGBAToRGB, FlipImage, RotateImage, CropImage, PadImage
+// and ShrinkImage reading and writing a whole image in turn.
+// Operations are given as name:arg,arg,... e.g. crop:0,0,1000,800
+
+#ifndef IMAGEOPERATIONS_HPP_
+#define IMAGEOPERATIONS_HPP_
+
+#include <sstream>
+
+#include "itkImage.h"
+#include "itkRGBPixel.h"
+#include "itkRGBAPixel.h"
+#include "itkExtractImageFilter.h"
+#include "itkConstantPadImageFilter.h"
+#include "itkGaussianDownsampleImageFilter.h"
+
+#include "IOHelpers.hpp"
+#include "RotateFlip.hpp"
+#include "RGBAToRGB.hpp"
+#include "IntensityMapping.hpp"
+
+using namespace std;
+
+namespace ImageOperations {
+  typedef itk::RGBPixel< unsigned char > PixelType;
+  typedef itk::Image< PixelType, 2 > ImageType;
+  typedef itk::RGBAPixel< unsigned char > RGBAPixelType;
+  typedef itk::Image< RGBAPixelType, 2 > RGBAImageType;
+
+  struct Operation {
+    string name;
+    vector< unsigned int > arguments;
+  };
+
+  inline string Usage()
+  {
+    return
+      "  rgba                        read the input as RGBA and fix its channels, as ConvertRGBAToRGB; first only\n"
+      "  flip                        reflect through the vertical axis, as FlipImage\n"
+      "  rotate                      rotate 90 degrees clockwise, as RotateImage\n"
+      "  crop:x,y,width,height       keep a region, as CropImage; read on its own if first\n"
+      "  pad:left,right,top,bottom[,value]\n"
+      "                              pad with a constant, 0 by default, as PadImage\n"
+      "  shrink:factor               smooth with a Gaussian of sigma factor and downsample, as ShrinkImage --fused\n"
+      "  rescale[:maximum]           stretch intensities to [0, maximum], 255 by default, with RescaleIntensity's\n"
+      "                              arithmetic, taking the range over all channels together\n";
+  }
+
+  // whether the operation is known, with the right number of arguments in range
+  inline bool IsValid(const Operation& operation)
+  {
+    const unsigned int n = operation.arguments.size();
+    if( operation.name == "rgba" || operation.name == "flip" || operation.name == "rotate" ) return n == 0;
+    if( operation.name == "crop" ) return n == 4;
+    if( operation.name == "pad" ) return n == 4 || ( n == 5 && operation.arguments[4] <= 255 );
+    if( operation.name == "shrink" ) return n == 1 && operation.arguments[0] > 0;
+    if( operation.name == "rescale" ) return n == 0 || ( n == 1 && operation.arguments[0] <= 255 );
+    return false;
+  }
+
+  inline Operation Parse(const string& specification)
+  {
+    Operation operation;
+    const string::size_type colon = specification.find(':');
+    operation.name = specification.substr(0, colon);
+    if( colon != string::npos )
+    {
+      stringstream arguments( specification.substr(colon + 1) );
+      string argument;
+      while( getline(arguments, argument, ',') )
+      {
+        unsigned int value;
+        stringstream parser(argument);
+        if( !(parser >> value) || !parser.eof() )
+        {
+          cerr << "Bad argument \"" << argument << "\" to " << operation.name << "." << endl;
+          exit(EXIT_FAILURE);
+        }
+        operation.arguments.push_back(value);
+      }
+    }
+
+    if( !IsValid(operation) )
+    {
+      cerr << "Unknown operation or wrong arguments: " << specification << endl;
+      cerr << "Operations are:" << endl << Usage();
+      exit(EXIT_FAILURE);
+    }
+    return operation;
+  }
+
+  inline vector< Operation > Parse(const vector< string >& specifications)
+  {
+    vector< Operation > operations;
+    for(unsigned int i=0; i<specifications.size(); ++i)
+    {
+      operations.push_back( Parse(specifications[i]) );
+      if( operations.back().name == "rgba" && i > 0 )
+      {
+        cerr << "rgba must be the first operation." << endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    return operations;
+  }
+
+  // operations throw itk::ExceptionObject on failure, which Run reports
+  inline void Update(itk::ProcessObject *process, unsigned int numberOfThreads)
+  {
+    if( numberOfThreads ) process->SetNumberOfThreads( numberOfThreads );
+    process->Update();
+  }
+
+  // The RGBA reader is offset by a channel, so what it calls red is the alpha
+  inline ImageType::Pointer ConvertRGBAToRGB(const RGBAImageType *input, unsigned int numberOfThreads = 0)
+  {
+    bool alphaIsZero;
+    ImageType::Pointer output = RGBAToRGB::Convert< RGBAImageType, ImageType >( input, alphaIsZero, numberOfThreads );
+    if( !alphaIsZero )
+    {
+      throw itk::ExceptionObject(__FILE__, __LINE__, "Non-zero alpha in input image!");
+    }
+    return output;
+  }
+
+  inline ImageType::RegionType CropRegion(const Operation& operation)
+  {
+    ImageType::RegionType region;
+    region.SetIndex(0, operation.arguments[0]);
+    region.SetIndex(1, operation.arguments[1]);
+    region.SetSize(0, operation.arguments[2]);
+    region.SetSize(1, operation.arguments[3]);
+    return region;
+  }
+
+  inline ImageType::Pointer Crop(const ImageType *input, const Operation& operation, unsigned int numberOfThreads = 0)
+  {
+    typedef itk::ExtractImageFilter< ImageType, ImageType > CropperType;
+    CropperType::Pointer cropper = CropperType::New();
+    cropper->SetInput( input );
+    cropper->SetExtractionRegion( CropRegion(operation) );
+    Update( cropper, numberOfThreads );
+    return cropper->GetOutput();
+  }
+
+  inline ImageType::Pointer Pad(const ImageType *input, const Operation& operation, unsigned int numberOfThreads = 0)
+  {
+    ImageType::SizeType lower, upper;
+    lower[0] = operation.arguments[0];
+    upper[0] = operation.arguments[1];
+    lower[1] = operation.arguments[2];
+    upper[1] = operation.arguments[3];
+    const unsigned char value = operation.arguments.size() > 4 ? operation.arguments[4] : 0;
+
+    typedef itk::ConstantPadImageFilter< ImageType, ImageType > PadderType;
+    PadderType::Pointer padder = PadderType::New();
+    padder->SetInput( input );
+    padder->SetPadLowerBound( lower );
+    padder->SetPadUpperBound( upper );
+    padder->SetConstant( PixelType(value) );
+    Update( padder, numberOfThreads );
+    return padder->GetOutput();
+  }
+
+  inline ImageType::Pointer Shrink(const ImageType *input, const Operation& operation, unsigned int numberOfThreads = 0)
+  {
+    typedef itk::GaussianDownsampleImageFilter< ImageType > DownsamplerType;
+    DownsamplerType::Pointer downsampler = DownsamplerType::New();
+    downsampler->SetInput( input );
+    downsampler->SetShrinkFactor( operation.arguments[0] );
+    Update( downsampler, numberOfThreads );
+    return downsampler->GetOutput();
+  }
+
+  // stretches all channels together onto [0, maximum] in place, through the same
+  // lookup table as RescaleIntensity, with the range taken over every channel
+  inline void Rescale(ImageType *image, const Operation& operation, unsigned int numberOfThreads = 0)
+  {
+    const unsigned int maximum = operation.arguments.empty() ? 255 : operation.arguments[0];
+    unsigned char *data = reinterpret_cast< unsigned char* >( image->GetBufferPointer() );
+    const unsigned long length = image->GetBufferedRegion().GetNumberOfPixels() * PixelType::Length;
+    if( length == 0 ) return;
+
+    unsigned char low, high;
+    IntensityMapping::FindExtrema( data, length, low, high, numberOfThreads );
+    IntensityMapping::Mapping mapping( low, high );
+    mapping.Rescale( 0, maximum );
+    IntensityMapping::ApplyInPlace( data, length, mapping.GetTable(), numberOfThreads );
+    image->Modified();
+  }
+
+  // the number of leading operations Read does
+  inline unsigned int OperationsDoneOnRead(const vector< Operation >& operations)
+  {
+    return !operations.empty() && ( operations[0].name == "rgba" || operations[0].name == "crop" ) ? 1 : 0;
+  }
+
+  // the input, or as little of it as the first operation needs
+  inline ImageType::Pointer Read(const string& fileName, const vector< Operation >& operations)
+  {
+    if( !operations.empty() && operations[0].name == "rgba" )
+    {
+      return ConvertRGBAToRGB( readImage< RGBAImageType >(fileName) );
+    }
+    if( !operations.empty() && operations[0].name == "crop" )
+    {
+      return Crop( readImageRegion< ImageType >(fileName, CropRegion(operations[0])), operations[0] );
+    }
+
+    ImageType::Pointer image = readImage< ImageType >(fileName);
+    image->DisconnectPipeline();
+    return image;
+  }
+
+  // applies operation to image, possibly in place, returning the result
+  inline ImageType::Pointer Apply(ImageType::Pointer image, const Operation& operation, unsigned int numberOfThreads = 0)
+  {
+    ImageType::Pointer output = image;
+    if( operation.name == "rgba" )    throw itk::ExceptionObject(__FILE__, __LINE__, "rgba must be the first operation.");
+    if( operation.name == "flip" )    RotateFlip::Flip< ImageType >( image, 0, numberOfThreads );
+    if( operation.name == "rotate" )  output = RotateFlip::RotateClockwise< ImageType >( image, numberOfThreads );
+    if( operation.name == "crop" )    output = Crop( image, operation, numberOfThreads );
+    if( operation.name == "pad" )     output = Pad( image, operation, numberOfThreads );
+    if( operation.name == "shrink" )  output = Shrink( image, operation, numberOfThreads );
+    if( operation.name == "rescale" ) Rescale( image, operation, numberOfThreads );
+
+    output->DisconnectPipeline();
+    return output;
+  }
+
+  // applies the operations from first on in order, each dropping its input when done
+  inline ImageType::Pointer Apply(ImageType::Pointer image, const vector< Operation >& operations,
+                                  unsigned int first = 0, unsigned int numberOfThreads = 0)
+  {
+    for(unsigned int i=first; i<operations.size(); ++i)
+    {
+      image = Apply(image, operations[i], numberOfThreads);
+    }
+    return image;
+  }
+
+  // reads the input and applies the operations to it
+  inline ImageType::Pointer Run(const string& inputFile, const vector< Operation >& operations)
+  {
+    try {
+      ImageType::Pointer image = Read(inputFile, operations);
+      return Apply(image, operations, OperationsDoneOnRead(operations));
+    }
+    catch( itk::ExceptionObject & err ) {
+      cerr << "ExceptionObject caught while processing " << inputFile << "." << endl;
+      cerr << err << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+#endif
@@ -1,8 +1,23 @@
+// printImageStats reports the statistics of an image already in memory.
+// The ImageStats namespace gathers statistics of images or volumes of any size,
+// reading them a slab at a time where their format allows, and accumulating each
+// slab in parallel with an accumulator per thread. Accumulators hold moments,
+// combined by Welford's and Chan et al.'s updates so that they stay accurate over
+// billions of pixels, and a histogram of fixed bins, from which percentiles are
+// taken. Accumulators merge, so one can cover a whole stack of images.
+
 #ifndef IMAGE_STATS_HPP_
 #define IMAGE_STATS_HPP_
 
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
 #include "itkStatisticsImageFilter.h"
 
+#include "IOHelpers.hpp"
+#include "ParallelFor.hpp"
+
 using namespace std;
 
 template<class TImage>
@@ -32,4 +47,204 @@ void printImageStats(typename TImage::Pointer image)
   
 }
 
+namespace ImageStats {
+  // pixels whose moments are computed in two passes, while they're in cache,
+  // before being merged into an accumulator's
+  const unsigned long BlockSize = 4096;
+
+  // bins of equal width covering [lower, upper); values outside it fall in the end bins
+  struct HistogramRange {
+    double lower, upper;
+    unsigned int bins;
+
+    HistogramRange(double l = 0, double u = 256, unsigned int b = 256):
+    lower(l), upper(u), bins(b) {}
+
+    double BinWidth() const { return ( upper - lower ) / bins; }
+
+    double BinLower(unsigned int bin) const { return lower + bin * BinWidth(); }
+  };
+
+  class Accumulator {
+  public:
+    Accumulator(const HistogramRange& range = HistogramRange()):
+    m_Range(range), m_Scale(range.bins / ( range.upper - range.lower )),
+    m_Count(0), m_Mean(0), m_M2(0), m_Sum(0),
+    m_Minimum(numeric_limits< double >::max()), m_Maximum(-numeric_limits< double >::max()),
+    m_Below(0), m_Above(0), m_Histogram(range.bins, 0) {}
+
+    template <typename PixelType>
+    void Add(const PixelType *begin, const PixelType *end)
+    {
+      const double lastBin = m_Range.bins - 1;
+      while( begin != end )
+      {
+        const PixelType *blockEnd = begin + min< unsigned long >( BlockSize, end - begin );
+
+        double sum = 0, minimum = m_Minimum, maximum = m_Maximum;
+        unsigned long below = 0, above = 0;
+        for(const PixelType *p=begin; p!=blockEnd; ++p)
+        {
+          const double value = *p;
+          sum += value;
+          minimum = min(minimum, value);
+          maximum = max(maximum, value);
+
+          const double bin = ( value - m_Range.lower ) * m_Scale;
+          if( bin < 0 ) ++below;
+          if( bin >= m_Range.bins ) ++above;
+          ++m_Histogram[ static_cast< unsigned int >( max(0.0, min(lastBin, bin)) ) ];
+        }
+
+        const unsigned long n = blockEnd - begin;
+        const double mean = sum / n;
+        double m2 = 0;
+        for(const PixelType *p=begin; p!=blockEnd; ++p)
+        {
+          const double deviation = *p - mean;
+          m2 += deviation * deviation;
+        }
+
+        MergeMoments(n, mean, m2);
+        m_Sum += sum;
+        m_Minimum = minimum;
+        m_Maximum = maximum;
+        m_Below += below;
+        m_Above += above;
+        begin = blockEnd;
+      }
+    }
+
+    // other must have the same histogram range
+    void Merge(const Accumulator& other)
+    {
+      MergeMoments(other.m_Count, other.m_Mean, other.m_M2);
+      m_Sum += other.m_Sum;
+      m_Minimum = min(m_Minimum, other.m_Minimum);
+      m_Maximum = max(m_Maximum, other.m_Maximum);
+      m_Below += other.m_Below;
+      m_Above += other.m_Above;
+      for(unsigned int bin=0; bin<m_Histogram.size(); ++bin) m_Histogram[bin] += other.m_Histogram[bin];
+    }
+
+    unsigned long GetCount() const { return m_Count; }
+    double GetMinimum() const { return m_Minimum; }
+    double GetMaximum() const { return m_Maximum; }
+    double GetMean() const { return m_Mean; }
+    double GetSum() const { return m_Sum; }
+
+    // the sample variance, as StatisticsImageFilter's
+    double GetVariance() const { return m_Count > 1 ? m_M2 / ( m_Count - 1 ) : 0; }
+    double GetSigma() const { return sqrt( GetVariance() ); }
+
+    // the number of values below and above the histogram's range
+    unsigned long GetBelow() const { return m_Below; }
+    unsigned long GetAbove() const { return m_Above; }
+
+    const HistogramRange& GetRange() const { return m_Range; }
+    const vector< unsigned long >& GetHistogram() const { return m_Histogram; }
+
+    // The lower edge of the bin holding the nearest-rank percentile, kept within
+    // [minimum, maximum], so exact for integer values in bins of width 1
+    double GetPercentile(double percent) const
+    {
+      if( m_Count == 0 ) return 0;
+      const unsigned long rank = max< unsigned long >( 1, static_cast< unsigned long >( ceil( percent / 100 * m_Count ) ) );
+
+      unsigned long cumulative = 0;
+      unsigned int bin = 0;
+      for(; bin<m_Histogram.size() - 1; ++bin)
+      {
+        cumulative += m_Histogram[bin];
+        if( cumulative >= rank ) break;
+      }
+      return min( m_Maximum, max( m_Minimum, m_Range.BinLower(bin) ) );
+    }
+
+  private:
+    void MergeMoments(unsigned long n, double mean, double m2)
+    {
+      if( n == 0 ) return;
+      const unsigned long count = m_Count + n;
+      const double delta = mean - m_Mean;
+      m_Mean += delta * n / count;
+      m_M2 += m2 + delta * delta * ( static_cast< double >( m_Count ) * n / count );
+      m_Count = count;
+    }
+
+    HistogramRange m_Range;
+    double m_Scale;
+    unsigned long m_Count;
+    double m_Mean, m_M2, m_Sum, m_Minimum, m_Maximum;
+    unsigned long m_Below, m_Above;
+    vector< unsigned long > m_Histogram;
+  };
+
+  // splits values into one contiguous part per task, each with its own accumulator
+  template <typename PixelType>
+  struct AccumulateParts {
+    const PixelType *values;
+    unsigned long length;
+    vector< Accumulator > accumulators;
+
+    AccumulateParts(const PixelType *v, unsigned long l, unsigned int parts, const HistogramRange& range):
+    values(v), length(l), accumulators(parts, Accumulator(range)) {}
+
+    void operator()(unsigned int part)
+    {
+      const unsigned long begin = length * part / accumulators.size();
+      const unsigned long end = length * ( part + 1 ) / accumulators.size();
+      accumulators[part].Add(values + begin, values + end);
+    }
+  };
+
+  // adds length values to accumulator, numberOfThreads = 0 using ITK's global default
+  template <typename PixelType>
+  void Accumulate(const PixelType *values, unsigned long length, Accumulator& accumulator, unsigned int numberOfThreads = 0)
+  {
+    if( numberOfThreads == 0 ) numberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+    if( numberOfThreads == 1 || length < numberOfThreads * BlockSize )
+    {
+      accumulator.Add(values, values + length);
+      return;
+    }
+
+    AccumulateParts< PixelType > accumulateParts(values, length, numberOfThreads, accumulator.GetRange());
+    parallelFor(numberOfThreads, accumulateParts, numberOfThreads);
+    for(unsigned int part=0; part<numberOfThreads; ++part) accumulator.Merge( accumulateParts.accumulators[part] );
+  }
+
+  // Adds the pixels of an image file to accumulator, reading slabs of about slabPixels
+  // pixels at a time if its format can stream, or all of it at once otherwise,
+  // as for compressed MetaImages, which ITK would inflate from the start for every slab
+  template <typename ImageType>
+  void AccumulateFile(const string& fileName, Accumulator& accumulator, unsigned long slabPixels, unsigned int numberOfThreads = 0)
+  {
+    typedef typename ImageType::RegionType RegionType;
+    const RegionType largest = readImageInformation< ImageType >(fileName)->GetLargestPossibleRegion();
+    if( largest.GetNumberOfPixels() == 0 ) return;
+
+    // slabs along the outermost axis longer than a pixel, so that each is contiguous
+    unsigned int axis = ImageType::ImageDimension - 1;
+    while( axis > 0 && largest.GetSize(axis) == 1 ) --axis;
+    const unsigned long length = largest.GetSize(axis);
+
+    const bool streams = canStreamRead(fileName);
+    const unsigned long slabLength = streams ? max< unsigned long >( 1, slabPixels / ( largest.GetNumberOfPixels() / length ) ) : length;
+    typename ImageType::Pointer image;
+    if( !streams ) image = readImage< ImageType >(fileName);
+
+    for(unsigned long start=0; start<length; start+=slabLength)
+    {
+      RegionType slab = largest;
+      slab.SetIndex(axis, largest.GetIndex(axis) + start);
+      slab.SetSize(axis, min(slabLength, length - start));
+      if( streams ) image = readImageRegion< ImageType >(fileName, slab, numberOfThreads);
+
+      const typename ImageType::PixelType *values = image->GetBufferPointer() + image->ComputeOffset( slab.GetIndex() );
+      Accumulate(values, slab.GetNumberOfPixels(), accumulator, numberOfThreads);
+    }
+  }
+}
+
 #endif
@@ -0,0 +1,252 @@
+// Maps the intensities of 8-bit images through a chain of invert, rescale and
+// colormap steps in a single pass. Every step is a function of one byte, so the
+// chain composes into one 256-entry lookup table. The steps are monotonic, so the
+// range of values each one sees, which rescaling and colormapping depend on,
+// follows from the input's minimum and maximum, found in one SSE2 pass.
+// The arithmetic of each step is that of the ITK filter it replaces, so results
+// are identical to InvertIntensityImageFilter, RescaleIntensityImageFilter and
+// ScalarToRGBColormapImageFilter's Jet colormap.
+
+#ifndef INTENSITYMAPPING_HPP_
+#define INTENSITYMAPPING_HPP_
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "itkImage.h"
+#include "itkRGBPixel.h"
+
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace IntensityMapping {
+  typedef itk::Image< unsigned char, 2 > ImageType;
+  typedef itk::RGBPixel< unsigned char > RGBPixelType;
+  typedef itk::Image< RGBPixelType, 2 > RGBImageType;
+
+  // bytes handled by each parallel task
+  const unsigned long ChunkSize = 1 << 20;
+
+  inline unsigned int NumberOfChunks(unsigned long length)
+  {
+    return ( length + ChunkSize - 1 ) / ChunkSize;
+  }
+
+  struct FindExtremaOfChunks {
+    const unsigned char *data;
+    unsigned long length;
+    vector< unsigned char > minima, maxima;
+
+    FindExtremaOfChunks(const unsigned char *d, unsigned long l):
+    data(d), length(l), minima(NumberOfChunks(l), 255), maxima(NumberOfChunks(l), 0) {}
+
+    void operator()(unsigned int chunk)
+    {
+      const unsigned char *begin = data + chunk * ChunkSize;
+      const unsigned char *end = begin + min(ChunkSize, length - chunk * ChunkSize);
+      unsigned char low = 255, high = 0;
+
+      const unsigned char *p = begin;
+#ifdef __SSE2__
+      __m128i lows = _mm_set1_epi8(char(255)), highs = _mm_setzero_si128();
+      for(; p + 16 <= end; p += 16)
+      {
+        const __m128i values = _mm_loadu_si128( reinterpret_cast< const __m128i* >(p) );
+        lows = _mm_min_epu8(lows, values);
+        highs = _mm_max_epu8(highs, values);
+      }
+      unsigned char lanes[16];
+      _mm_storeu_si128( reinterpret_cast< __m128i* >(lanes), lows );
+      low = *min_element(lanes, lanes + 16);
+      _mm_storeu_si128( reinterpret_cast< __m128i* >(lanes), highs );
+      high = *max_element(lanes, lanes + 16);
+#endif
+      for(; p < end; ++p)
+      {
+        low = min(low, *p);
+        high = max(high, *p);
+      }
+
+      minima[chunk] = low;
+      maxima[chunk] = high;
+    }
+  };
+
+  // the range of length bytes; an empty range's is [255, 0]
+  inline void FindExtrema(const unsigned char *data, unsigned long length, unsigned char& minimum, unsigned char& maximum, unsigned int numberOfThreads = 0)
+  {
+    FindExtremaOfChunks findExtrema(data, length);
+    parallelFor(findExtrema.minima.size(), findExtrema, numberOfThreads);
+    minimum = findExtrema.minima.empty() ? 255 : *min_element(findExtrema.minima.begin(), findExtrema.minima.end());
+    maximum = findExtrema.maxima.empty() ? 0 : *max_element(findExtrema.maxima.begin(), findExtrema.maxima.end());
+  }
+
+  // the range of an image's values
+  inline void FindExtrema(const ImageType *image, unsigned char& minimum, unsigned char& maximum, unsigned int numberOfThreads = 0)
+  {
+    FindExtrema(image->GetBufferPointer(), image->GetBufferedRegion().GetNumberOfPixels(), minimum, maximum, numberOfThreads);
+  }
+
+  // A chain of steps, applied in the order they're added, starting from the identity.
+  // Tracks the range of values the chain produces for inputs in [minimum, maximum].
+  class Mapping {
+  public:
+    Mapping(unsigned char minimum, unsigned char maximum):
+    m_Minimum(minimum), m_Maximum(maximum)
+    {
+      for(unsigned int v=0; v<256; ++v) m_Table[v] = v;
+    }
+
+    // as InvertIntensityImageFilter, with its default maximum
+    void Invert(unsigned char maximum = 255)
+    {
+      for(unsigned int v=0; v<256; ++v) m_Table[v] = static_cast< unsigned char >( maximum - m_Table[v] );
+      const unsigned char low = maximum - m_Maximum, high = maximum - m_Minimum;
+      m_Minimum = low;
+      m_Maximum = high;
+    }
+
+    // as RescaleIntensityImageFilter
+    void Rescale(unsigned char outputMinimum, unsigned char outputMaximum)
+    {
+      double scale = 0;
+      if( m_Minimum != m_Maximum )
+      {
+        scale = ( static_cast< double >( outputMaximum ) - static_cast< double >( outputMinimum ) )
+              / ( static_cast< double >( m_Maximum ) - static_cast< double >( m_Minimum ) );
+      }
+      else if( m_Maximum != 0 )
+      {
+        scale = ( static_cast< double >( outputMaximum ) - static_cast< double >( outputMinimum ) )
+              / static_cast< double >( m_Maximum );
+      }
+      const double shift = static_cast< double >( outputMinimum ) - static_cast< double >( m_Minimum ) * scale;
+
+      for(unsigned int v=0; v<256; ++v)
+      {
+        const double value = static_cast< double >( m_Table[v] ) * scale + shift;
+        // values outside the tracked range don't occur in the image, so only need to be defined
+        unsigned char result = value <= 0 ? 0 : value >= 255 ? 255 : static_cast< unsigned char >( value );
+        result = min(max(result, outputMinimum), outputMaximum);
+        m_Table[v] = result;
+      }
+      if( m_Minimum <= m_Maximum )
+      {
+        const unsigned char low = m_Table[m_Minimum], high = m_Table[m_Maximum];
+        m_Minimum = low;
+        m_Maximum = high;
+      }
+    }
+
+    // Ends the chain with ScalarToRGBColormapImageFilter's Jet colormap, scaled by
+    // the range of values reaching it, in the RealType of unsigned char, double,
+    // as ColormapFunctor's RescaleInputValue does
+    void Jet(RGBPixelType table[256]) const
+    {
+      typedef double RealType;
+      const RealType minimum = m_Minimum, range = static_cast< RealType >( m_Maximum - m_Minimum );
+      for(unsigned int v=0; v<256; ++v)
+      {
+        // a single value has no range to scale by, so maps to the bottom of the colormap
+        RealType value = range != 0 ? ( static_cast< RealType >( m_Table[v] ) - minimum ) / range : 0;
+        value = max(0.0, value);
+        value = min(1.0, value);
+
+        const RealType red   = -fabs( 3.95 * ( value - 0.7460 ) ) + 1.5;
+        const RealType green = -fabs( 3.95 * ( value - 0.492 ) ) + 1.5;
+        const RealType blue  = -fabs( 3.95 * ( value - 0.2385 ) ) + 1.5;
+
+        table[v].SetRed( RescaleRGBComponent(red) );
+        table[v].SetGreen( RescaleRGBComponent(green) );
+        table[v].SetBlue( RescaleRGBComponent(blue) );
+      }
+    }
+
+    const unsigned char * GetTable() const { return m_Table; }
+
+  private:
+    // clamped, then as RescaleRGBComponentValue, truncating onto [0, 255]
+    static unsigned char RescaleRGBComponent(double v)
+    {
+      v = max(0.0, v);
+      v = min(1.0, v);
+      return static_cast< unsigned char >( 255.0 * v );
+    }
+
+    unsigned char m_Table[256];
+    unsigned char m_Minimum, m_Maximum;
+  };
+
+  // out[i] = table[in[i]], a chunk at a time
+  template <typename OutputType>
+  struct ApplyTable {
+    const unsigned char *in;
+    OutputType *out;
+    unsigned long length;
+    const OutputType *table;
+
+    void operator()(unsigned int chunk)
+    {
+      const unsigned long begin = chunk * ChunkSize, end = min(begin + ChunkSize, length);
+      unsigned long i = begin;
+      // unrolled, as a 256-entry lookup doesn't vectorise with SSE2
+      for(; i + 4 <= end; i += 4)
+      {
+        out[i]     = table[in[i]];
+        out[i + 1] = table[in[i + 1]];
+        out[i + 2] = table[in[i + 2]];
+        out[i + 3] = table[in[i + 3]];
+      }
+      for(; i < end; ++i) out[i] = table[in[i]];
+    }
+  };
+
+  // maps length bytes through table in place
+  inline void ApplyInPlace(unsigned char *data, unsigned long length, const unsigned char *table, unsigned int numberOfThreads = 0)
+  {
+    ApplyTable< unsigned char > applyTable;
+    applyTable.in = data;
+    applyTable.out = data;
+    applyTable.length = length;
+    applyTable.table = table;
+    parallelFor(NumberOfChunks(length), applyTable, numberOfThreads);
+  }
+
+  // a new image of input mapped through table
+  template <typename OutputImageType>
+  typename OutputImageType::Pointer Apply(const ImageType *input, const typename OutputImageType::PixelType *table, unsigned int numberOfThreads = 0)
+  {
+    typename OutputImageType::Pointer output = OutputImageType::New();
+    output->CopyInformation( input );
+    output->SetRegions( input->GetBufferedRegion() );
+    output->Allocate();
+
+    ApplyTable< typename OutputImageType::PixelType > applyTable;
+    applyTable.in = input->GetBufferPointer();
+    applyTable.out = output->GetBufferPointer();
+    applyTable.length = input->GetBufferedRegion().GetNumberOfPixels();
+    applyTable.table = table;
+    parallelFor(NumberOfChunks(applyTable.length), applyTable, numberOfThreads);
+
+    return output;
+  }
+
+  inline ImageType::Pointer Apply(const ImageType *input, const Mapping& mapping, unsigned int numberOfThreads = 0)
+  {
+    return Apply< ImageType >(input, mapping.GetTable(), numberOfThreads);
+  }
+
+  inline RGBImageType::Pointer ApplyJet(const ImageType *input, const Mapping& mapping, unsigned int numberOfThreads = 0)
+  {
+    RGBPixelType table[256];
+    mapping.Jet(table);
+    return Apply< RGBImageType >(input, table, numberOfThreads);
+  }
+}
+
+#endif
@@ -0,0 +1,258 @@
+// Finds the largest eigenvalue, by value, of each of an array of symmetric 2x2 or 3x3
+// tensors, and its unit eigenvector v, writing |lambda * v[i]| for each component,
+// as ExtractLargestEigenvectorFilter does with ITK's general eigen-analysis.
+// Tensors are stored as SymmetricSecondRankTensor stores them, the upper triangle
+// row by row, and worked on in double precision, as ITK's solver does.
+// 3x3 eigenvalues are the trigonometric solution of the characteristic cubic, and
+// the eigenvector is the longest cross product of two rows of (A - lambda I).
+// With SSE2, pairs of tensors share registers, all but the acos and cos.
+// Results match ITK's to about 1e-5 of lambda, except where the largest eigenvalue
+// is repeated, and any unit vector in its eigenspace is an eigenvector.
+
+#ifndef LARGESTEIGENVECTOR_HPP_
+#define LARGESTEIGENVECTOR_HPP_
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace LargestEigenvector {
+  // tensors solved by each parallel task
+  const unsigned long TileSize = 1 << 14;
+
+  // how small, relative to the rows' squared lengths, the longest cross product can be
+  // before the largest eigenvalue is treated as repeated
+  const double Degenerate = 1e-20;
+
+  inline void Solve2(const float *tensor, float *out)
+  {
+    const double a00 = tensor[0], a01 = tensor[1], a11 = tensor[2];
+    const double m = ( a00 + a11 ) / 2, d = ( a00 - a11 ) / 2;
+    const double lambda = m + sqrt( d * d + a01 * a01 );
+
+    // perpendicular to the longer row of (A - lambda I)
+    const double r00 = a00 - lambda, r11 = a11 - lambda;
+    double v0 = -a01, v1 = r00;
+    if( a01 * a01 + r11 * r11 > r00 * r00 + a01 * a01 )
+    {
+      v0 = -r11;
+      v1 = a01;
+    }
+    const double length = sqrt( v0 * v0 + v1 * v1 );
+    if( length == 0 )
+    {
+      v0 = 0;
+      v1 = 1;
+    }
+    else
+    {
+      v0 /= length;
+      v1 /= length;
+    }
+
+    out[0] = fabs( v0 * lambda );
+    out[1] = fabs( v1 * lambda );
+  }
+
+  // the largest root of the characteristic cubic, given its shifted form's p and q
+  inline double LargestRoot(double m, double p, double q)
+  {
+    if( p <= 0 ) return m;
+    const double r = min( 1.0, max( -1.0, q / ( p * sqrt(p) ) ) );
+    return m + 2 * sqrt(p) * cos( acos(r) / 3 );
+  }
+
+  inline void Cross(const double *a, const double *b, double *c)
+  {
+    c[0] = a[1] * b[2] - a[2] * b[1];
+    c[1] = a[2] * b[0] - a[0] * b[2];
+    c[2] = a[0] * b[1] - a[1] * b[0];
+  }
+
+  inline double Dot(const double *a, const double *b)
+  {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  }
+
+  inline void Solve3(const float *tensor, float *out)
+  {
+    const double a00 = tensor[0], a01 = tensor[1], a02 = tensor[2], a11 = tensor[3], a12 = tensor[4], a22 = tensor[5];
+
+    // A = m I + B, whose eigenvalues are m + 2 sqrt(p) cos(phi + 2k pi / 3)
+    const double m = ( a00 + a11 + a22 ) / 3;
+    const double b00 = a00 - m, b11 = a11 - m, b22 = a22 - m;
+    const double p = ( b00 * b00 + b11 * b11 + b22 * b22 + 2 * ( a01 * a01 + a02 * a02 + a12 * a12 ) ) / 6;
+    const double q = ( b00 * ( b11 * b22 - a12 * a12 ) - a01 * ( a01 * b22 - a12 * a02 ) + a02 * ( a01 * a12 - b11 * a02 ) ) / 2;
+    const double lambda = LargestRoot(m, p, q);
+
+    // v is perpendicular to every row of (A - lambda I)
+    const double rows[3][3] = { { a00 - lambda, a01, a02 }, { a01, a11 - lambda, a12 }, { a02, a12, a22 - lambda } };
+    double v[3], c[3];
+    Cross(rows[0], rows[1], v);
+    double length = Dot(v, v);
+    Cross(rows[0], rows[2], c);
+    if( Dot(c, c) > length )
+    {
+      copy(c, c + 3, v);
+      length = Dot(c, c);
+    }
+    Cross(rows[1], rows[2], c);
+    if( Dot(c, c) > length )
+    {
+      copy(c, c + 3, v);
+      length = Dot(c, c);
+    }
+
+    const double scale = Dot(rows[0], rows[0]) + Dot(rows[1], rows[1]) + Dot(rows[2], rows[2]);
+    if( length <= Degenerate * scale * scale )
+    {
+      // at most one independent row, so any perpendicular will do;
+      // crossing the longest with the axis it's least along
+      unsigned int longest = 0;
+      for(unsigned int i=1; i<3; ++i) if( Dot(rows[i], rows[i]) > Dot(rows[longest], rows[longest]) ) longest = i;
+      const double *row = rows[longest];
+      double axis[3] = { 0, 0, 0 };
+      if( Dot(row, row) == 0 )
+      {
+        // A = lambda I
+        axis[2] = 1;
+        copy(axis, axis + 3, v);
+      }
+      else
+      {
+        axis[ fabs(row[0]) <= fabs(row[1]) && fabs(row[0]) <= fabs(row[2]) ? 0 : fabs(row[1]) <= fabs(row[2]) ? 1 : 2 ] = 1;
+        Cross(row, axis, v);
+      }
+      length = Dot(v, v);
+    }
+
+    const double s = fabs(lambda) / sqrt(length);
+    for(unsigned int i=0; i<3; ++i) out[i] = fabs( v[i] * s );
+  }
+
+#ifdef __SSE2__
+  inline __m128d Select(__m128d mask, __m128d a, __m128d b)
+  {
+    return _mm_or_pd( _mm_and_pd(mask, a), _mm_andnot_pd(mask, b) );
+  }
+
+  // a pair of tensors to two lanes of a register, or back
+  inline __m128d Load(const float *tensors, unsigned int i, unsigned int stride)
+  {
+    return _mm_set_pd( tensors[stride + i], tensors[i] );
+  }
+
+  // Solve3 on tensors[0] and tensors[1], with the same arithmetic,
+  // except for lanes whose largest eigenvalue is repeated, which are left to Solve3
+  inline void Solve3Pair(const float *tensors, float *out)
+  {
+    const __m128d a00 = Load(tensors, 0, 6), a01 = Load(tensors, 1, 6), a02 = Load(tensors, 2, 6);
+    const __m128d a11 = Load(tensors, 3, 6), a12 = Load(tensors, 4, 6), a22 = Load(tensors, 5, 6);
+    const __m128d two = _mm_set1_pd(2);
+
+    const __m128d m = _mm_div_pd( _mm_add_pd( _mm_add_pd(a00, a11), a22 ), _mm_set1_pd(3) );
+    const __m128d b00 = _mm_sub_pd(a00, m), b11 = _mm_sub_pd(a11, m), b22 = _mm_sub_pd(a22, m);
+    const __m128d diagonal = _mm_add_pd( _mm_add_pd( _mm_mul_pd(b00, b00), _mm_mul_pd(b11, b11) ), _mm_mul_pd(b22, b22) );
+    const __m128d off = _mm_add_pd( _mm_add_pd( _mm_mul_pd(a01, a01), _mm_mul_pd(a02, a02) ), _mm_mul_pd(a12, a12) );
+    const __m128d p = _mm_div_pd( _mm_add_pd( diagonal, _mm_mul_pd(two, off) ), _mm_set1_pd(6) );
+    const __m128d q = _mm_div_pd( _mm_add_pd( _mm_sub_pd(
+                        _mm_mul_pd( b00, _mm_sub_pd( _mm_mul_pd(b11, b22), _mm_mul_pd(a12, a12) ) ),
+                        _mm_mul_pd( a01, _mm_sub_pd( _mm_mul_pd(a01, b22), _mm_mul_pd(a12, a02) ) ) ),
+                        _mm_mul_pd( a02, _mm_sub_pd( _mm_mul_pd(a01, a12), _mm_mul_pd(b11, a02) ) ) ), two );
+
+    double ms[2], ps[2], qs[2], lambdas[2];
+    _mm_storeu_pd(ms, m);
+    _mm_storeu_pd(ps, p);
+    _mm_storeu_pd(qs, q);
+    for(unsigned int i=0; i<2; ++i) lambdas[i] = LargestRoot(ms[i], ps[i], qs[i]);
+    const __m128d lambda = _mm_loadu_pd(lambdas);
+
+    const __m128d r0[3] = { _mm_sub_pd(a00, lambda), a01, a02 };
+    const __m128d r1[3] = { a01, _mm_sub_pd(a11, lambda), a12 };
+    const __m128d r2[3] = { a02, a12, _mm_sub_pd(a22, lambda) };
+    const __m128d *rows[3] = { r0, r1, r2 };
+    const unsigned int pairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+
+    __m128d v[3], length = _mm_setzero_pd();
+    for(unsigned int k=0; k<3; ++k)
+    {
+      const __m128d *a = rows[ pairs[k][0] ], *b = rows[ pairs[k][1] ];
+      __m128d c[3];
+      c[0] = _mm_sub_pd( _mm_mul_pd(a[1], b[2]), _mm_mul_pd(a[2], b[1]) );
+      c[1] = _mm_sub_pd( _mm_mul_pd(a[2], b[0]), _mm_mul_pd(a[0], b[2]) );
+      c[2] = _mm_sub_pd( _mm_mul_pd(a[0], b[1]), _mm_mul_pd(a[1], b[0]) );
+      const __m128d cc = _mm_add_pd( _mm_add_pd( _mm_mul_pd(c[0], c[0]), _mm_mul_pd(c[1], c[1]) ), _mm_mul_pd(c[2], c[2]) );
+      if( k == 0 )
+      {
+        copy(c, c + 3, v);
+        length = cc;
+        continue;
+      }
+      const __m128d longer = _mm_cmpgt_pd(cc, length);
+      for(unsigned int i=0; i<3; ++i) v[i] = Select(longer, c[i], v[i]);
+      length = Select(longer, cc, length);
+    }
+
+    __m128d scale = _mm_setzero_pd();
+    for(unsigned int r=0; r<3; ++r)
+      for(unsigned int i=0; i<3; ++i) scale = _mm_add_pd( scale, _mm_mul_pd(rows[r][i], rows[r][i]) );
+    const int degenerate = _mm_movemask_pd( _mm_cmple_pd( length, _mm_mul_pd( _mm_set1_pd(Degenerate), _mm_mul_pd(scale, scale) ) ) );
+
+    const __m128d signBit = _mm_set1_pd(-0.0);
+    const __m128d s = _mm_div_pd( _mm_andnot_pd(signBit, lambda), _mm_sqrt_pd(length) );
+    double results[3][2];
+    for(unsigned int i=0; i<3; ++i) _mm_storeu_pd( results[i], _mm_andnot_pd( signBit, _mm_mul_pd(v[i], s) ) );
+
+    for(unsigned int lane=0; lane<2; ++lane)
+    {
+      if( degenerate & ( 1 << lane ) ) Solve3(tensors + 6 * lane, out + 3 * lane);
+      else for(unsigned int i=0; i<3; ++i) out[3 * lane + i] = results[i][lane];
+    }
+  }
+#endif
+
+  template <unsigned int Dimension>
+  struct SolveTiles {
+    static const unsigned int Components = Dimension * ( Dimension + 1 ) / 2;
+    const float *tensors;
+    float *out;
+    unsigned long n;
+
+    void operator()(unsigned int tile)
+    {
+      const unsigned long begin = tile * TileSize, end = min(begin + TileSize, n);
+      unsigned long i = begin;
+      if( Dimension == 3 )
+      {
+#ifdef __SSE2__
+        for(; i + 2 <= end; i += 2) Solve3Pair(tensors + i * Components, out + i * Dimension);
+#endif
+        for(; i < end; ++i) Solve3(tensors + i * Components, out + i * Dimension);
+      }
+      else
+      {
+        for(; i < end; ++i) Solve2(tensors + i * Components, out + i * Dimension);
+      }
+    }
+  };
+
+  // solves n tensors of Dimension 2 or 3, writing Dimension values for each
+  template <unsigned int Dimension>
+  void Solve(const float *tensors, float *out, unsigned long n, unsigned int numberOfThreads = 0)
+  {
+    SolveTiles< Dimension > solveTiles;
+    solveTiles.tensors = tensors;
+    solveTiles.out = out;
+    solveTiles.n = n;
+    parallelFor(( n + TileSize - 1 ) / TileSize, solveTiles, numberOfThreads);
+  }
+}
+
+#endif
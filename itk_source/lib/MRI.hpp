@@ -6,6 +6,8 @@
 #ifndef MRI_HPP_
 #define MRI_HPP_
 
+#include <assert.h>
+
 #include "itkImage.h"
 #include "itkImageFileReader.h"
 #include "itkResampleImageFilter.h"
@@ -15,7 +17,24 @@
 #include "itkChangeInformationImageFilter.h"
 #include "itkImageMaskSpatialObject.h"
 #include "itkImageRegionIterator.h"
-#include "itkExtractImageFilter.h"
+
+// A slice's pixels, imported from a plane of a volume's buffer, keeping that
+// buffer alive for as long as the slice: resamplers swap in a new buffer on
+// every update, which would otherwise leave slices handed out earlier dangling.
+template< typename TContainer, typename TVolumeContainer >
+class PlaneContainer: public TContainer {
+public:
+  typedef PlaneContainer Self;
+  typedef TContainer Superclass;
+  typedef itk::SmartPointer< Self > Pointer;
+  typedef itk::SmartPointer< const Self > ConstPointer;
+  itkNewMacro(Self);
+  
+  typename TVolumeContainer::Pointer volumeContainer;
+  
+protected:
+  PlaneContainer() {}
+};
 
 class MRI {
 public:
@@ -39,8 +58,6 @@ public:
   typedef itk::NearestNeighborInterpolateImageFunction< MaskVolumeType, double > MaskVolumeInterpolatorType;
   typedef itk::ResampleImageFilter< VolumeType, VolumeType > ResamplerType;
   typedef itk::ResampleImageFilter< MaskVolumeType, MaskVolumeType > MaskResamplerType;
-  typedef itk::ExtractImageFilter< VolumeType, SliceType > SliceExtractorType;
-  typedef itk::ExtractImageFilter< MaskVolumeType, MaskSliceType > MaskSliceExtractorType;
   typedef itk::ImageRegionIterator< MaskVolumeType > IteratorType;
   typedef itk::ImageMaskSpatialObject< 3 > MaskType3D;
   typedef itk::ImageMaskSpatialObject< 2 > MaskType2D;
@@ -63,13 +80,15 @@ public:
   VolumeType::SpacingType resamplerSpacing;
   VolumeType::SizeType resamplerSize;
   MaskResamplerType::Pointer maskResampler;
-  SliceExtractorType::Pointer sliceExtractor;
-  MaskSliceExtractorType::Pointer maskSliceExtractor;
+  // the slices that are resampled, [firstSlice, endSlice)
+  unsigned int firstSlice, endSlice;
   
 	
 	MRI(char const *inputFileName, VolumeType::SpacingType spacing, VolumeType::SizeType size, double initialResizeFactor):
 	  resamplerSpacing(spacing),
-	  resamplerSize(size) {
+	  resamplerSize(size),
+	  firstSlice(0),
+	  endSlice(size[2]) {
 		readFile(inputFileName);
 		rescaleIntensity();
 		resizeImage(initialResizeFactor);
@@ -141,85 +160,92 @@ public:
     resampler->SetInput( originalImage );
 		resampler->SetInterpolator( volumeInterpolator );
 		resampler->SetOutputSpacing( resamplerSpacing );
-		resampler->SetSize( resamplerSize );
 		resampler->SetTransform( transform );
 		resampler->SetDefaultPixelValue( 127 );
 		maskResampler = MaskResamplerType::New();
 		maskResampler->SetInput( originalMask );
 		maskResampler->SetInterpolator( maskVolumeInterpolator );
 		maskResampler->SetOutputSpacing( resamplerSpacing );
-		maskResampler->SetSize( resamplerSize );
 		maskResampler->SetTransform( transform );
 		
-		// extract image filters
-    sliceExtractor = SliceExtractorType::New();
-    sliceExtractor->SetInput( resampler->GetOutput() );
-		maskSliceExtractor = MaskSliceExtractorType::New();
-    maskSliceExtractor->SetInput( maskResampler->GetOutput() );
-    
+		setResampledRegion();
+		
     // masks
     for(unsigned int i=0; i<resamplerSize[2]; i++) {
   		masks2D.push_back( MaskType2D::New() );
     }		
 	}
 	
+	// only resample the slices in the range, keeping their z-indices
+	void setResampledRegion() {
+		VolumeType::IndexType start = {{0, 0, 0}};
+		start[2] = firstSlice;
+		VolumeType::SizeType size = resamplerSize;
+		size[2] = endSlice - firstSlice;
+		resampler->SetOutputStartIndex( start );
+		resampler->SetSize( size );
+		maskResampler->SetOutputStartIndex( start );
+		maskResampler->SetSize( size );
+	}
+	
+	// Slices are views onto the z-planes of the resampled volume, each keeping
+	// the volume's buffer alive, so resampling again leaves slices handed out
+	// earlier intact and the views are rebuilt. Slices outside the range are null.
+	template< typename TSlice, typename TVolume >
+	void buildSliceViews(TVolume *volume, vector< typename TSlice::Pointer >& views) {
+		typedef PlaneContainer< typename TSlice::PixelContainer, typename TVolume::PixelContainer > PlaneContainerType;
+		typename TSlice::RegionType region;
+		typename TSlice::SpacingType spacing;
+		typename TSlice::PointType origin;
+		for(unsigned int d=0; d<2; d++) {
+			region.SetIndex(d, volume->GetLargestPossibleRegion().GetIndex()[d]);
+			region.SetSize(d, volume->GetLargestPossibleRegion().GetSize()[d]);
+			spacing[d] = volume->GetSpacing()[d];
+			origin[d] = volume->GetOrigin()[d];
+		}
+		const unsigned long planeSize = region.GetNumberOfPixels();
+		
+		views.assign(resamplerSize[2], typename TSlice::Pointer());
+		for(unsigned int i=firstSlice; i<endSlice; i++) {
+			typename PlaneContainerType::Pointer plane = PlaneContainerType::New();
+			// the volume's container owns the buffer, and the plane holds on to it
+			plane->volumeContainer = volume->GetPixelContainer();
+			plane->SetImportPointer(volume->GetBufferPointer() + (i - firstSlice) * planeSize, planeSize, false);
+			
+			views[i] = TSlice::New();
+			views[i]->SetRegions( region );
+			views[i]->SetSpacing( spacing );
+			views[i]->SetOrigin( origin );
+			views[i]->SetPixelContainer( plane.GetPointer() );
+		}
+	}
+	
 	void buildSlices() {
 	  resampler->Update();
-	  
-	  // set up extractor
-    VolumeType::SizeType size = resamplerSize;
-    size[2] = 0;
-    
-    VolumeType::IndexType sliceIndex = {{0, 0, 0}};
-    
-    VolumeType::RegionType sliceRegion;
-    sliceRegion.SetSize( size );
-    sliceRegion.SetIndex( sliceIndex );
-    
-    slices.clear();
-    
-    for(unsigned int i=0; i<resamplerSize[2]; i++) {
-      // Set the z-coordinate of the slice to be extracted
-      sliceRegion.SetIndex(2, i);
-      
-      sliceExtractor->SetExtractionRegion( sliceRegion );
-      
-      // add output to slices vector
-      sliceExtractor->Update();
-      slices.push_back( sliceExtractor->GetOutput() );
-      slices.back()->DisconnectPipeline();
-    }
-    
+	  buildSliceViews< SliceType >( resampler->GetOutput(), slices );
 	}
 	
 	void buildMaskSlices() {
     maskResampler->Update();
-	  
-	  // set up extractor
-    VolumeType::SizeType size = resamplerSize;
-    size[2] = 0;
-    
-    VolumeType::IndexType sliceIndex = {{0, 0, 0}};
+    buildSliceViews< MaskSliceType >( maskResampler->GetOutput(), maskSlices );
     
-    VolumeType::RegionType sliceRegion;
-    sliceRegion.SetSize( size );
-    sliceRegion.SetIndex( sliceIndex );
-    
-    maskSlices.clear();
-    
-    for(unsigned int i=0; i<resamplerSize[2]; i++) {
-      // Set the z-coordinate of the slice to be extracted
-      sliceRegion.SetIndex(2, i);
-      
-      maskSliceExtractor->SetExtractionRegion( sliceRegion );
-    
-      // add output to slices vector
-      maskSliceExtractor->Update();
-      maskSlices.push_back( maskSliceExtractor->GetOutput() );
-  		masks2D[i]->SetImage( maskSlices.back() );
-      maskSlices.back()->DisconnectPipeline();
+    // point the masks at the new views
+    for(unsigned int i=firstSlice; i<endSlice; i++) {
+  		masks2D[i]->SetImage( maskSlices[i] );
     }
-  
+	}
+	
+	// Only resamples slices [first, end), leaving the others null,
+	// for when only some of the slices are needed
+	void SetSliceRange(unsigned int first, unsigned int end) {
+		assert( first < end && end <= resamplerSize[2] );
+		firstSlice = first;
+		endSlice = end;
+		setResampledRegion();
+		slices.clear();
+		maskSlices.clear();
+		buildSlices();
+		buildMaskSlices();
 	}
 	
 	void SetTransformParameters(TransformType::Pointer inputTransform) {
@@ -0,0 +1,196 @@
+// Writes MetaImage (.mha) files with the pixel data compressed in parallel.
+// The buffer is cut into blocks that are deflated concurrently and joined with
+// sync flushes into a single zlib stream, with the checksum combined from each
+// block's, so the file is an ordinary compressed MetaImage that any reader can open.
+
+#ifndef METAIMAGEWRITER_HPP_
+#define METAIMAGEWRITER_HPP_
+
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+
+#include "itkImage.h"
+#include "itkPixelTraits.h"
+#include "itkByteSwapper.h"
+#include "itk_zlib.h"
+
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace MetaImageWriter {
+  // uncompressed bytes per block; big enough that the sync flush between blocks costs nothing
+  const unsigned long BlockSize = 1 << 20;
+
+  // MetaImage element type of each component type, or 0 if unsupported
+  template <typename T> struct ElementType { static const char * Name() { return 0; } };
+  template <> struct ElementType< char >           { static const char * Name() { return "MET_CHAR"; } };
+  template <> struct ElementType< signed char >    { static const char * Name() { return "MET_CHAR"; } };
+  template <> struct ElementType< unsigned char >  { static const char * Name() { return "MET_UCHAR"; } };
+  template <> struct ElementType< short >          { static const char * Name() { return "MET_SHORT"; } };
+  template <> struct ElementType< unsigned short > { static const char * Name() { return "MET_USHORT"; } };
+  template <> struct ElementType< int >            { static const char * Name() { return "MET_INT"; } };
+  template <> struct ElementType< unsigned int >   { static const char * Name() { return "MET_UINT"; } };
+  template <> struct ElementType< float >          { static const char * Name() { return "MET_FLOAT"; } };
+  template <> struct ElementType< double >         { static const char * Name() { return "MET_DOUBLE"; } };
+
+  // whether Write can handle the image, rather than leaving it to ITK's writer:
+  // a whole, non-empty buffer, as an image that hasn't been updated has neither
+  template <typename ImageType>
+  bool CanWrite(const ImageType *image, const string& fileName)
+  {
+    typedef typename itk::PixelTraits< typename ImageType::PixelType >::ValueType ComponentType;
+    const string extension = ".mha";
+    return ElementType< ComponentType >::Name() != 0 &&
+           fileName.size() >= extension.size() &&
+           fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0 &&
+           image->GetBufferedRegion().GetNumberOfPixels() > 0 &&
+           image->GetBufferedRegion() == image->GetLargestPossibleRegion();
+  }
+
+  struct DeflateBlocks {
+    const char *data;
+    unsigned long length;
+    int compressionLevel;
+    vector< vector< char > > blocks;
+    vector< uLong > checksums;
+
+    DeflateBlocks(const char *d, unsigned long l, int level):
+    data(d), length(l), compressionLevel(level),
+    blocks(length == 0 ? 1 : ( length + BlockSize - 1 ) / BlockSize),
+    checksums(blocks.size()) {}
+
+    unsigned long GetBlockLength(unsigned int b) const
+    {
+      const unsigned long begin = b * BlockSize;
+      return length - begin < BlockSize ? length - begin : BlockSize;
+    }
+
+    void operator()(unsigned int b)
+    {
+      const Bytef *in = reinterpret_cast< const Bytef* >(data + b * BlockSize);
+      const unsigned long blockLength = GetBlockLength(b);
+      const bool last = b + 1 == blocks.size();
+
+      // raw deflate, without a zlib header or checksum of its own
+      z_stream stream;
+      memset(&stream, 0, sizeof(stream));
+      if( deflateInit2(&stream, compressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+      {
+        cerr << "Couldn't initialise compression." << endl;
+        exit(EXIT_FAILURE);
+      }
+
+      // room for the worst case, plus the empty stored block of the sync flush
+      blocks[b].resize(deflateBound(&stream, blockLength) + 16);
+      stream.next_in = const_cast< Bytef* >(in);
+      stream.avail_in = blockLength;
+      stream.next_out = reinterpret_cast< Bytef* >(&blocks[b][0]);
+      stream.avail_out = blocks[b].size();
+
+      // only the last block marks the end of the stream
+      const int result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+      if( ( last ? result != Z_STREAM_END : result != Z_OK ) || stream.avail_in != 0 )
+      {
+        cerr << "Couldn't compress block " << b << "." << endl;
+        exit(EXIT_FAILURE);
+      }
+      blocks[b].resize(blocks[b].size() - stream.avail_out);
+      deflateEnd(&stream);
+
+      checksums[b] = adler32(adler32(0L, Z_NULL, 0), in, blockLength);
+    }
+  };
+
+  // compressionLevel is zlib's: 0 for no compression, 1 fastest to 9 smallest, or -1 for its default
+  template <typename ImageType>
+  void Write(const ImageType *image, const string& fileName, int compressionLevel = Z_DEFAULT_COMPRESSION, unsigned int numberOfThreads = 0)
+  {
+    typedef typename ImageType::PixelType PixelType;
+    typedef itk::PixelTraits< PixelType > TraitsType;
+    const unsigned int dimension = ImageType::ImageDimension;
+
+    const char *data = reinterpret_cast< const char* >(image->GetBufferPointer());
+    const unsigned long length = image->GetBufferedRegion().GetNumberOfPixels() * sizeof(PixelType);
+
+    vector< char > header, trailer;
+    DeflateBlocks deflateBlocks(data, compressionLevel == 0 ? 0 : length, compressionLevel);
+    unsigned long compressedSize = 0;
+    if( compressionLevel != 0 )
+    {
+      parallelFor(deflateBlocks.blocks.size(), deflateBlocks, numberOfThreads);
+
+      // zlib header, and the checksum of the whole buffer, most significant byte first
+      header.push_back(0x78);
+      header.push_back(0x9c);
+      uLong checksum = deflateBlocks.checksums[0];
+      for(unsigned int b=1; b<deflateBlocks.blocks.size(); ++b)
+      {
+        checksum = adler32_combine(checksum, deflateBlocks.checksums[b], deflateBlocks.GetBlockLength(b));
+      }
+      for(int shift=24; shift>=0; shift-=8) trailer.push_back( (checksum >> shift) & 0xff );
+
+      compressedSize = header.size() + trailer.size();
+      for(unsigned int b=0; b<deflateBlocks.blocks.size(); ++b) compressedSize += deflateBlocks.blocks[b].size();
+    }
+
+    ofstream file(fileName.c_str(), ios::binary);
+    file << setprecision(17);
+    file << "ObjectType = Image" << endl;
+    file << "NDims = " << dimension << endl;
+    file << "BinaryData = True" << endl;
+    file << "BinaryDataByteOrderMSB = " << ( itk::ByteSwapper< int >::SystemIsBigEndian() ? "True" : "False" ) << endl;
+    file << "CompressedData = " << ( compressionLevel != 0 ? "True" : "False" ) << endl;
+    if( compressionLevel != 0 ) file << "CompressedDataSize = " << compressedSize << endl;
+
+    // each row is the direction of an image axis
+    file << "TransformMatrix =";
+    for(unsigned int i=0; i<dimension; ++i)
+      for(unsigned int j=0; j<dimension; ++j)
+        file << " " << image->GetDirection()[j][i];
+    file << endl;
+
+    // physical position of the first pixel
+    typename ImageType::PointType offset;
+    image->TransformIndexToPhysicalPoint(image->GetBufferedRegion().GetIndex(), offset);
+    file << "Offset =";
+    for(unsigned int i=0; i<dimension; ++i) file << " " << offset[i];
+    file << endl;
+
+    file << "CenterOfRotation =";
+    for(unsigned int i=0; i<dimension; ++i) file << " 0";
+    file << endl;
+    file << "ElementSpacing =";
+    for(unsigned int i=0; i<dimension; ++i) file << " " << image->GetSpacing()[i];
+    file << endl;
+    file << "DimSize =";
+    for(unsigned int i=0; i<dimension; ++i) file << " " << image->GetBufferedRegion().GetSize()[i];
+    file << endl;
+    if( TraitsType::Dimension > 1 ) file << "ElementNumberOfChannels = " << TraitsType::Dimension << endl;
+    file << "ElementType = " << ElementType< typename TraitsType::ValueType >::Name() << endl;
+    file << "ElementDataFile = LOCAL" << endl;
+
+    if( compressionLevel != 0 )
+    {
+      file.write(&header[0], header.size());
+      for(unsigned int b=0; b<deflateBlocks.blocks.size(); ++b)
+      {
+        if( !deflateBlocks.blocks[b].empty() ) file.write(&deflateBlocks.blocks[b][0], deflateBlocks.blocks[b].size());
+      }
+      file.write(&trailer[0], trailer.size());
+    }
+    else
+    {
+      file.write(data, length);
+    }
+
+    if( !file )
+    {
+      cerr << "Couldn't write " << fileName << "." << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,57 @@
+// Runs a functor over the indices [0, n) on ITK's thread pool.
+// The functor must provide void operator()(unsigned int i), and is shared
+// between threads, so anything it writes to must be indexed by i.
+
+#ifndef PARALLELFOR_HPP_
+#define PARALLELFOR_HPP_
+
+#include "itkMultiThreader.h"
+
+template <typename FunctorType>
+struct ParallelForData {
+  FunctorType *functor;
+  unsigned int n;
+};
+
+template <typename FunctorType>
+ITK_THREAD_RETURN_TYPE parallelForThreadCallback(void *arg)
+{
+  itk::MultiThreader::ThreadInfoStruct *info = static_cast< itk::MultiThreader::ThreadInfoStruct* >(arg);
+  ParallelForData< FunctorType > *data = static_cast< ParallelForData< FunctorType >* >(info->UserData);
+
+  // interleave indices between threads, so that expensive neighbouring items are spread out
+  for(unsigned int i=info->ThreadID; i<data->n; i+=info->NumberOfThreads)
+  {
+    (*data->functor)(i);
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+// numberOfThreads = 0 uses ITK's global default
+template <typename FunctorType>
+void parallelFor(unsigned int n, FunctorType& functor, unsigned int numberOfThreads = 0)
+{
+  if(n == 0) return;
+
+  if(numberOfThreads == 0) numberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  if(numberOfThreads > n) numberOfThreads = n;
+
+  // no point spinning up threads for a single one
+  if(numberOfThreads <= 1)
+  {
+    for(unsigned int i=0; i<n; ++i) functor(i);
+    return;
+  }
+
+  ParallelForData< FunctorType > data;
+  data.functor = &functor;
+  data.n = n;
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(parallelForThreadCallback< FunctorType >, &data);
+  threader->SingleMethodExecute();
+}
+
+#endif
@@ -0,0 +1,107 @@
+// Converts RGBA images as read by ITK's offset RGBA reader into RGB images, in parallel.
+// The reader puts the real alpha, which should be zero, in the first byte of each pixel,
+// so the conversion drops that byte, keeping the other three in order. With SSSE3,
+// sixteen pixels at a time are packed with pshufb and their alphas OR-ed together.
+// SSSE3 is enabled by building with -mssse3, e.g. through the USE_SSSE3 CMake option.
+
+#ifndef RGBATORGB_HPP_
+#define RGBATORGB_HPP_
+
+#include <vector>
+#include <algorithm>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "itkImage.h"
+
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace RGBAToRGB {
+  // pixels converted by each parallel task
+  const unsigned long ChunkSize = 1 << 18;
+
+  struct ConvertChunks {
+    const unsigned char *rgba;
+    unsigned char *rgb;
+    unsigned long pixels;
+    // per chunk, to avoid sharing a flag between threads
+    vector< unsigned char > alphas;
+
+    ConvertChunks(const unsigned char *in, unsigned char *out, unsigned long n):
+    rgba(in), rgb(out), pixels(n), alphas(( n + ChunkSize - 1 ) / ChunkSize, 0) {}
+
+    void operator()(unsigned int chunk)
+    {
+      const unsigned long begin = chunk * ChunkSize, end = min(begin + ChunkSize, pixels);
+      const unsigned char *in = rgba + 4 * begin;
+      unsigned char *out = rgb + 3 * begin;
+      unsigned long i = begin;
+      unsigned char alpha = 0;
+
+#ifdef __SSSE3__
+      // packs bytes 1-3 of each of four pixels into the low 12 bytes, zeroing the rest
+      const __m128i pack = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -128, -128, -128, -128);
+      const __m128i alphaMask = _mm_set1_epi32(0xff);
+      __m128i alphaBytes = _mm_setzero_si128();
+      for(; i + 16 <= end; i += 16, in += 64, out += 48)
+      {
+        const __m128i p0 = _mm_loadu_si128( reinterpret_cast< const __m128i* >(in) );
+        const __m128i p1 = _mm_loadu_si128( reinterpret_cast< const __m128i* >(in + 16) );
+        const __m128i p2 = _mm_loadu_si128( reinterpret_cast< const __m128i* >(in + 32) );
+        const __m128i p3 = _mm_loadu_si128( reinterpret_cast< const __m128i* >(in + 48) );
+        alphaBytes = _mm_or_si128( alphaBytes, _mm_and_si128( _mm_or_si128( _mm_or_si128(p0, p1), _mm_or_si128(p2, p3) ), alphaMask ) );
+
+        const __m128i s0 = _mm_shuffle_epi8(p0, pack);
+        const __m128i s1 = _mm_shuffle_epi8(p1, pack);
+        const __m128i s2 = _mm_shuffle_epi8(p2, pack);
+        const __m128i s3 = _mm_shuffle_epi8(p3, pack);
+
+        // join the four 12-byte runs into three 16-byte stores
+        _mm_storeu_si128( reinterpret_cast< __m128i* >(out),      _mm_or_si128( s0, _mm_slli_si128(s1, 12) ) );
+        _mm_storeu_si128( reinterpret_cast< __m128i* >(out + 16), _mm_or_si128( _mm_srli_si128(s1, 4), _mm_slli_si128(s2, 8) ) );
+        _mm_storeu_si128( reinterpret_cast< __m128i* >(out + 32), _mm_or_si128( _mm_srli_si128(s2, 8), _mm_slli_si128(s3, 4) ) );
+      }
+      alpha = _mm_movemask_epi8( _mm_cmpeq_epi8(alphaBytes, _mm_setzero_si128()) ) != 0xffff;
+#endif
+
+      for(; i < end; ++i, in += 4, out += 3)
+      {
+        alpha |= in[0];
+        out[0] = in[1];
+        out[1] = in[2];
+        out[2] = in[3];
+      }
+
+      alphas[chunk] = alpha != 0;
+    }
+  };
+
+  // Converts pixels from rgba to rgb, returning whether all their alphas were zero.
+  inline bool Convert(const unsigned char *rgba, unsigned char *rgb, unsigned long pixels, unsigned int numberOfThreads = 0)
+  {
+    ConvertChunks convertChunks(rgba, rgb, pixels);
+    parallelFor(convertChunks.alphas.size(), convertChunks, numberOfThreads);
+    return find(convertChunks.alphas.begin(), convertChunks.alphas.end(), 1) == convertChunks.alphas.end();
+  }
+
+  // an RGB image of input's channels, setting alphaIsZero to whether all its alphas were
+  template <typename RGBAImageType, typename RGBImageType>
+  typename RGBImageType::Pointer Convert(const RGBAImageType *input, bool& alphaIsZero, unsigned int numberOfThreads = 0)
+  {
+    typename RGBImageType::Pointer output = RGBImageType::New();
+    output->CopyInformation( input );
+    output->SetRegions( input->GetBufferedRegion() );
+    output->Allocate();
+
+    alphaIsZero = Convert( reinterpret_cast< const unsigned char* >( input->GetBufferPointer() ),
+                           reinterpret_cast< unsigned char* >( output->GetBufferPointer() ),
+                           input->GetBufferedRegion().GetNumberOfPixels(), numberOfThreads );
+    return output;
+  }
+}
+
+#endif
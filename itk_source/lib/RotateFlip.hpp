@@ -0,0 +1,162 @@
+// Rotates, transposes and flips 2D images directly on their buffers, in parallel.
+// Transposes and rotations read and write in square tiles small enough that the
+// input rows a tile touches stay in cache while it's written, and allocate just
+// the output. Flips swap pixels in place. The geometry matches that of ITK's
+// PermuteAxesImageFilter and FlipImageFilter, flipping about the origin.
+
+#ifndef ROTATEFLIP_HPP_
+#define ROTATEFLIP_HPP_
+
+#include <algorithm>
+
+#include "itkImage.h"
+
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace RotateFlip {
+  // edge length in pixels of the tiles; 64x64 RGB pixels is 12KB each of input and output
+  const unsigned int TileSize = 64;
+
+  // out(x, y) = in(y, x), or in(y, inHeight - 1 - x) when flipping the output's x,
+  // one band of tile rows of the output at a time
+  template <typename ImageType>
+  struct TransposeTiles {
+    const typename ImageType::PixelType *in;
+    typename ImageType::PixelType *out;
+    unsigned long inWidth, inHeight;
+    bool flipX;
+
+    void operator()(unsigned int band)
+    {
+      // the output is inHeight wide and inWidth high
+      const unsigned long yBegin = band * TileSize, yEnd = min(yBegin + TileSize, inWidth);
+      for(unsigned long xBegin=0; xBegin<inHeight; xBegin+=TileSize)
+      {
+        const unsigned long xEnd = min(xBegin + TileSize, inHeight);
+        for(unsigned long y=yBegin; y<yEnd; ++y)
+        {
+          typename ImageType::PixelType *outRow = out + y * inHeight;
+          for(unsigned long x=xBegin; x<xEnd; ++x)
+          {
+            const unsigned long inY = flipX ? inHeight - 1 - x : x;
+            outRow[x] = in[inY * inWidth + y];
+          }
+        }
+      }
+    }
+  };
+
+  // reverses each row
+  template <typename ImageType>
+  struct FlipRows {
+    typename ImageType::PixelType *buffer;
+    unsigned long width;
+
+    void operator()(unsigned int y)
+    {
+      typename ImageType::PixelType *row = buffer + y * width;
+      reverse(row, row + width);
+    }
+  };
+
+  // swaps row y with its mirror image
+  template <typename ImageType>
+  struct SwapRows {
+    typename ImageType::PixelType *buffer;
+    unsigned long width, height;
+
+    void operator()(unsigned int y)
+    {
+      typename ImageType::PixelType *row = buffer + y * width;
+      swap_ranges(row, row + width, buffer + (height - 1 - y) * width);
+    }
+  };
+
+  // sets the origin FlipImageFilter gives when flipping about the origin
+  template <typename ImageType>
+  void FlipOrigin(ImageType *image, unsigned int axis)
+  {
+    typename ImageType::IndexType last = image->GetLargestPossibleRegion().GetIndex();
+    last[axis] += image->GetLargestPossibleRegion().GetSize()[axis] - 1;
+    typename ImageType::PointType origin;
+    image->TransformIndexToPhysicalPoint(last, origin);
+    origin[axis] *= -1;
+    image->SetOrigin(origin);
+  }
+
+  // an image with x and y swapped, and optionally the output then flipped
+  // along x, which is a 90 degree clockwise rotation
+  template <typename ImageType>
+  typename ImageType::Pointer Transpose(const ImageType *input, bool flipX = false, unsigned int numberOfThreads = 0)
+  {
+    // the geometry PermuteAxesImageFilter gives: the index axes are swapped,
+    // so the direction's columns are, and the origin stays where it was
+    const typename ImageType::RegionType& inputRegion = input->GetLargestPossibleRegion();
+    typename ImageType::RegionType region;
+    typename ImageType::SpacingType spacing;
+    typename ImageType::DirectionType direction;
+    for(unsigned int j=0; j<2; ++j)
+    {
+      region.SetIndex(j, inputRegion.GetIndex(1 - j));
+      region.SetSize(j, inputRegion.GetSize(1 - j));
+      spacing[j] = input->GetSpacing()[1 - j];
+      for(unsigned int i=0; i<2; ++i) direction[i][j] = input->GetDirection()[i][1 - j];
+    }
+
+    typename ImageType::Pointer output = ImageType::New();
+    output->SetRegions(region);
+    output->SetSpacing(spacing);
+    output->SetOrigin(input->GetOrigin());
+    output->SetDirection(direction);
+    output->Allocate();
+
+    TransposeTiles< ImageType > transposeTiles;
+    transposeTiles.in = input->GetBufferPointer();
+    transposeTiles.out = output->GetBufferPointer();
+    transposeTiles.inWidth = inputRegion.GetSize(0);
+    transposeTiles.inHeight = inputRegion.GetSize(1);
+    transposeTiles.flipX = flipX;
+    parallelFor(( transposeTiles.inWidth + TileSize - 1 ) / TileSize, transposeTiles, numberOfThreads);
+
+    if( flipX ) FlipOrigin(output.GetPointer(), 0);
+
+    return output;
+  }
+
+  template <typename ImageType>
+  typename ImageType::Pointer RotateClockwise(const ImageType *input, unsigned int numberOfThreads = 0)
+  {
+    return Transpose(input, true, numberOfThreads);
+  }
+
+  // flips the image along axis 0 (x) or 1 (y) in place
+  template <typename ImageType>
+  void Flip(ImageType *image, unsigned int axis, unsigned int numberOfThreads = 0)
+  {
+    const unsigned long width = image->GetLargestPossibleRegion().GetSize(0);
+    const unsigned long height = image->GetLargestPossibleRegion().GetSize(1);
+
+    if( axis == 0 )
+    {
+      FlipRows< ImageType > flipRows;
+      flipRows.buffer = image->GetBufferPointer();
+      flipRows.width = width;
+      parallelFor(height, flipRows, numberOfThreads);
+    }
+    else
+    {
+      SwapRows< ImageType > swapRows;
+      swapRows.buffer = image->GetBufferPointer();
+      swapRows.width = width;
+      swapRows.height = height;
+      parallelFor(height / 2, swapRows, numberOfThreads);
+    }
+
+    FlipOrigin(image, axis);
+    image->Modified();
+  }
+}
+
+#endif
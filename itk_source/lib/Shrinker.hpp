@@ -0,0 +1,266 @@
+// Smoothes and downsamples an RGB image file into another, as ShrinkImage does.
+// Given a strip height, the output is built a strip of rows at a time, each from
+// just the input rows it samples plus a margin covering the Gaussian's support,
+// so that only one strip's smoothed intermediates are held in memory at once.
+// The fused filter instead computes smoothed values at the output samples only,
+// with a truncated Gaussian, and streams strips through the writer.
+// Failures throw, so that batch tools can carry on with other images.
+
+#ifndef SHRINKER_HPP_
+#define SHRINKER_HPP_
+
+#include <cmath>
+
+#include "itkImage.h"
+#include "itkRGBPixel.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageIOFactory.h"
+#include "itkExtractImageFilter.h"
+#include "itkImageRegionIterator.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkVectorResampleImageFilter.h"
+#include "itkIdentityTransform.h"
+#include "itkVectorLinearInterpolateImageFunction.h"
+#include "itkRecursiveGaussianImageFilter.h"
+#include "itkGaussianDownsampleImageFilter.h"
+
+using namespace std;
+
+namespace Shrinker {
+  const unsigned int Dimension = 2;
+  typedef itk::RGBPixel< unsigned char > PixelType;
+  typedef itk::Image< PixelType, Dimension > ImageType;
+
+  // The recursive Gaussian's influence decays exponentially, at roughly e^(-1.7 d / sigma),
+  // so beyond 12 sigma it is many orders of magnitude below a single intensity level
+  const double MarginInSigmas = 12;
+
+  // smooths the input and samples it at outputRegion of the downsampled grid;
+  // numberOfThreads = 0 leaves each filter ITK's default
+  inline ImageType::Pointer Shrink(const ImageType *inputImage, double factor, const ImageType::RegionType& outputRegion,
+                                   unsigned int numberOfThreads = 0)
+  {
+    typedef itk::RecursiveGaussianImageFilter< ImageType, ImageType > GaussianFilterType;
+
+    GaussianFilterType::Pointer smootherX = GaussianFilterType::New();
+    GaussianFilterType::Pointer smootherY = GaussianFilterType::New();
+
+    smootherX->SetInput( inputImage );
+    smootherY->SetInput( smootherX->GetOutput() );
+
+    // free each intermediate as soon as the next filter has used it
+    smootherX->ReleaseDataFlagOn();
+    smootherY->ReleaseDataFlagOn();
+
+    // The Sigma values to use in the smoothing filters is computed based on the
+    // pixel spacings of the input image and the factors provided as arguments.
+    const ImageType::SpacingType& inputSpacing = inputImage->GetSpacing();
+
+    smootherX->SetSigma( inputSpacing[0] * factor );
+    smootherY->SetSigma( inputSpacing[1] * factor );
+
+    smootherX->SetDirection( 0 );
+    smootherY->SetDirection( 1 );
+
+    smootherX->SetNormalizeAcrossScale( false );
+    smootherY->SetNormalizeAcrossScale( false );
+
+    typedef itk::VectorResampleImageFilter< ImageType, ImageType > ResampleFilterType;
+    ResampleFilterType::Pointer resampler = ResampleFilterType::New();
+
+    typedef itk::IdentityTransform< double, Dimension > TransformType;
+    TransformType::Pointer transform = TransformType::New();
+    transform->SetIdentity();
+    resampler->SetTransform( transform );
+
+    typedef itk::VectorLinearInterpolateImageFunction< ImageType, double > InterpolatorType;
+    InterpolatorType::Pointer interpolator = InterpolatorType::New();
+    resampler->SetInterpolator( interpolator );
+
+    ImageType::SpacingType spacing;
+    spacing[0] = inputSpacing[0] * factor;
+    spacing[1] = inputSpacing[1] * factor;
+
+    resampler->SetOutputSpacing( spacing );
+    resampler->SetOutputOrigin( inputImage->GetOrigin() );
+    resampler->SetOutputDirection( inputImage->GetDirection() );
+    resampler->SetOutputStartIndex( outputRegion.GetIndex() );
+    resampler->SetSize( outputRegion.GetSize() );
+    resampler->SetInput( smootherY->GetOutput() );
+
+    if( numberOfThreads )
+    {
+      smootherX->SetNumberOfThreads( numberOfThreads );
+      smootherY->SetNumberOfThreads( numberOfThreads );
+      resampler->SetNumberOfThreads( numberOfThreads );
+    }
+
+    resampler->Update();
+
+    ImageType::Pointer output = resampler->GetOutput();
+    output->DisconnectPipeline();
+    return output;
+  }
+
+  inline ImageType::RegionType OutputLargestRegion(const ImageType *inputImage, double factor)
+  {
+    ImageType::SizeType inputSize = inputImage->GetLargestPossibleRegion().GetSize();
+
+    typedef ImageType::SizeType::SizeValueType SizeValueType;
+    ImageType::SizeType size;
+    size[0] = static_cast< SizeValueType >( inputSize[0] / factor );
+    size[1] = static_cast< SizeValueType >( inputSize[1] / factor );
+
+    ImageType::IndexType index;
+    index.Fill(0);
+
+    return ImageType::RegionType( index, size );
+  }
+
+  // Full width input rows sampled by the strip's output rows, plus room
+  // for linear interpolation and the Gaussian's support either side.
+  // Whole rows keep the smoothing along x identical to the whole image path.
+  inline ImageType::RegionType StripInputRegion(const ImageType *inputImage, double factor, const ImageType::RegionType& stripRegion)
+  {
+    const ImageType::RegionType& largestRegion = inputImage->GetLargestPossibleRegion();
+    const long margin = static_cast< long >( ceil( MarginInSigmas * factor ) );
+    const long begin = largestRegion.GetIndex()[1];
+    const long end   = begin + static_cast< long >( largestRegion.GetSize()[1] );
+
+    const long firstRow = static_cast< long >( floor( stripRegion.GetIndex()[1] * factor ) ) - margin;
+    const long lastRow  = static_cast< long >( ceil( ( stripRegion.GetIndex()[1] + stripRegion.GetSize()[1] - 1 ) * factor ) ) + 1 + margin;
+
+    ImageType::RegionType region = largestRegion;
+    region.SetIndex( 1, max( firstRow, begin ) );
+    region.SetSize( 1, min( lastRow + 1, end ) - region.GetIndex()[1] );
+    return region;
+  }
+
+  // Shrinks inputFile into outputFile, stripHeight output rows at a time, 0 meaning
+  // the whole image, with the recursive Gaussians or, if fused, the truncated one
+  inline void ShrinkFile(const string& inputFile, const string& outputFile, unsigned int factor,
+                         unsigned int stripHeight, bool fused, unsigned int numberOfThreads = 0)
+  {
+    typedef itk::ImageFileReader< ImageType > ReaderType;
+    typedef itk::ImageFileWriter< ImageType > WriterType;
+
+    ReaderType::Pointer reader = ReaderType::New();
+    WriterType::Pointer writer = WriterType::New();
+    reader->SetFileName( inputFile );
+    writer->SetFileName( outputFile );
+
+    if( fused )
+    {
+      typedef itk::GaussianDownsampleImageFilter< ImageType > DownsamplerType;
+      DownsamplerType::Pointer downsampler = DownsamplerType::New();
+      downsampler->SetInput( reader->GetOutput() );
+      downsampler->SetShrinkFactor( factor );
+      if( numberOfThreads ) downsampler->SetNumberOfThreads( numberOfThreads );
+      writer->SetInput( downsampler->GetOutput() );
+
+      if( stripHeight > 0 )
+      {
+        downsampler->UpdateOutputInformation();
+        const unsigned int height = downsampler->GetOutput()->GetLargestPossibleRegion().GetSize()[1];
+        writer->SetNumberOfStreamDivisions( max( 1u, ( height + stripHeight - 1 ) / stripHeight ) );
+      }
+
+      writer->Update();
+      return;
+    }
+
+    if( stripHeight == 0 )
+    {
+      reader->Update();
+      writer->SetInput( Shrink( reader->GetOutput(), factor, OutputLargestRegion( reader->GetOutput(), factor ), numberOfThreads ) );
+      writer->Update();
+      return;
+    }
+
+    // only read the header, so that image IOs that support it can stream strips from disk
+    reader->UpdateOutputInformation();
+
+    ImageType::Pointer inputImage = reader->GetOutput();
+    const ImageType::RegionType largestRegion = OutputLargestRegion( inputImage, factor );
+
+    // paste strips straight into the output file if its format allows,
+    // otherwise assemble the much smaller output in memory and write it at the end
+    itk::ImageIOBase::Pointer outputIO = itk::ImageIOFactory::CreateImageIO( outputFile.c_str(), itk::ImageIOFactory::WriteMode );
+    const bool streamWrite = outputIO && outputIO->CanStreamWrite();
+
+    ImageType::Pointer outputImage;
+    if( !streamWrite )
+    {
+      outputImage = ImageType::New();
+      outputImage->SetRegions( largestRegion );
+      outputImage->SetOrigin( inputImage->GetOrigin() );
+      outputImage->SetDirection( inputImage->GetDirection() );
+      outputImage->SetSpacing( inputImage->GetSpacing() * factor );
+      outputImage->Allocate();
+    }
+
+    const unsigned int height = largestRegion.GetSize()[1];
+    for(unsigned int row=0; row < height; row += stripHeight)
+    {
+      ImageType::RegionType stripRegion = largestRegion;
+      stripRegion.SetIndex( 1, row );
+      stripRegion.SetSize( 1, min( stripHeight, height - row ) );
+
+      // extract just the input rows this strip depends on
+      typedef itk::ExtractImageFilter< ImageType, ImageType > ExtractorType;
+      ExtractorType::Pointer extractor = ExtractorType::New();
+      extractor->SetInput( inputImage );
+      extractor->SetExtractionRegion( StripInputRegion( inputImage, factor, stripRegion ) );
+      extractor->SetDirectionCollapseToSubmatrix();
+      if( numberOfThreads ) extractor->SetNumberOfThreads( numberOfThreads );
+      extractor->Update();
+
+      ImageType::Pointer strip = Shrink( extractor->GetOutput(), factor, stripRegion, numberOfThreads );
+
+      if( streamWrite )
+      {
+        // describe the strip as part of the whole output image
+        strip->SetLargestPossibleRegion( largestRegion );
+        itk::ImageIORegion ioRegion( Dimension );
+        itk::ImageIORegionAdaptor< Dimension >::Convert( stripRegion, ioRegion, largestRegion.GetIndex() );
+        writer->SetInput( strip );
+        writer->SetIORegion( ioRegion );
+        writer->Update();
+      }
+      else
+      {
+        itk::ImageRegionConstIterator< ImageType > in( strip, stripRegion );
+        itk::ImageRegionIterator< ImageType > out( outputImage, stripRegion );
+        for(; !in.IsAtEnd(); ++in, ++out) out.Set( in.Get() );
+      }
+    }
+
+    if( !streamWrite )
+    {
+      writer->SetInput( outputImage );
+      writer->Update();
+    }
+  }
+
+  // bytes needed to shrink inputFile: the whole original for formats that can't
+  // stream reads, two strips' smoothed intermediates, and the output
+  inline double EstimateMemory(const string& inputFile, unsigned int factor, unsigned int stripHeight)
+  {
+    itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO( inputFile.c_str(), itk::ImageIOFactory::ReadMode );
+    if( !imageIO ) return 0;
+    imageIO->SetFileName( inputFile );
+    imageIO->ReadImageInformation();
+
+    const double width = imageIO->GetDimensions(0), height = imageIO->GetDimensions(1);
+    const double pixelBytes = sizeof(PixelType);
+    const double stripRows = stripHeight ? min( height, ( stripHeight + 2 * MarginInSigmas + 2 ) * factor ) : height;
+
+    double bytes = width * height * pixelBytes / ( factor * factor );
+    bytes += 2 * width * stripRows * pixelBytes;
+    if( !imageIO->CanStreamRead() || stripHeight == 0 ) bytes += width * height * pixelBytes;
+    return bytes;
+  }
+}
+
+#endif
@@ -17,6 +17,7 @@
 #include "itkImageRegionIterator.h"
 
 #include "StackBase.hpp"
+#include "SliceMoments.hpp"
 
 template <typename TPixel,
           template<typename TInputImage, typename TOutputImage, typename TInterpolatorPrecisionType> class ResampleImageFilterType,
@@ -45,6 +46,8 @@ public:
 private:
 	SliceVectorType originalImages;
   SliceVectorType slices;
+  vector< SliceMoments > sliceMoments;
+  vector< bool > sliceMomentsCached;
 	typename VolumeType::Pointer volume;
 	MaskVectorType2D original2DMasks;
 	MaskVectorType2D resampled2DMasks;
@@ -140,6 +143,10 @@ public:
   
   SliceVectorType GetResampledSlices() { return slices; }
   
+  // moments of a resampled slice, computed on first request
+  // and cached until the slices are next rebuilt
+  const SliceMoments& GetResampledSliceMoments(unsigned int slice_number);
+  
   typename MaskType2D::Pointer GetResampled2DMask(unsigned int slice_number) {
     checkSliceNumber(slice_number);
     return resampled2DMasks[slice_number];
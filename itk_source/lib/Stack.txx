@@ -56,6 +56,8 @@ template <typename TPixel,
 void Stack< TPixel, ResampleImageFilterType, InterpolatorType >::initializeVectors() {
 	// initialise various data members once the number of images is available
 	numberOfTimesTooBig = vector< unsigned int >( GetSize(), 0 );
+  sliceMoments = vector< SliceMoments >( GetSize() );
+  sliceMomentsCached = vector< bool >( GetSize(), false );
   for(unsigned int slice_number = 0; slice_number < GetSize(); slice_number++) {
     slices.push_back( SliceType::New() );
     original2DMasks.push_back( MaskType2D::New() );
@@ -180,6 +182,25 @@ void Stack< TPixel, ResampleImageFilterType, InterpolatorType >::buildSlices()
     slices[slice_number] = resampler->GetOutput();
 		slices[slice_number]->DisconnectPipeline();
 	}
+	
+	// previously computed moments are now stale
+  sliceMomentsCached.assign( GetSize(), false );
+}
+
+template <typename TPixel,
+          template<typename TInputImage, typename TOutputImage, typename TInterpolatorPrecisionType> class ResampleImageFilterType,
+          template<typename TInputImage, typename TCoordRep> class InterpolatorType >
+const SliceMoments& Stack< TPixel, ResampleImageFilterType, InterpolatorType >::GetResampledSliceMoments(unsigned int slice_number)
+{
+  checkSliceNumber(slice_number);
+  
+  if( !sliceMomentsCached[slice_number] )
+  {
+    sliceMoments[slice_number] = computeSliceMoments( slices[slice_number].GetPointer() );
+    sliceMomentsCached[slice_number] = true;
+  }
+  
+  return sliceMoments[slice_number];
 }
 
 template <typename TPixel,
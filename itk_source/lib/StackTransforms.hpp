@@ -86,9 +86,13 @@ namespace StackTransforms {
       CenteredRigid2DTransformType::Pointer transform = CenteredRigid2DTransformType::New();
       typename InitializerType::Pointer initializer = InitializerType::New();
       initializer->SetTransform( transform );
-      initializer->SetFixedImage( fixedStack.GetResampledSlice(slice_number) );
       initializer->SetMovingImage( movingStack.GetOriginalImage(slice_number) );
-      try { initializer->InitializeTransform(); }
+      try
+      {
+        // fixed moments are cached by the stack, so only the moving side is computed here
+        initializer->SetFixedMoments( fixedStack.GetResampledSliceMoments(slice_number) );
+        initializer->InitializeTransform();
+      }
       catch( itk::ExceptionObject & err )
     	{
         cerr << "itk::ExceptionObject caught while initialising transforms." << endl;
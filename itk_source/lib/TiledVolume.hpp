@@ -0,0 +1,359 @@
+// Chunked on-disk image format, for volumes too big to compress or decompress whole.
+// The image is cut into fixed-size tiles, each compressed independently, and in parallel,
+// with zlib. The file is a fixed header, an index of each tile's offset and compressed size,
+// then the tiles, so a region can be read by decompressing just the tiles it touches.
+// Tiles are stored in order with x varying fastest, and hold their pixels the same way.
+// Numbers are written in the machine's native byte order.
+
+#ifndef TILEDVOLUME_HPP_
+#define TILEDVOLUME_HPP_
+
+#include <fstream>
+#include <cstring>
+#include <stdint.h>
+
+#include "itkImage.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itk_zlib.h"
+
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace TiledVolume {
+  const char Magic[8] = { 'T', 'I', 'L', 'E', 'V', 'O', 'L', '1' };
+  const string Extension = ".tvol";
+  const unsigned int MaxDimension = 3;
+
+  struct Header {
+    char magic[8];
+    uint32_t dimension;
+    uint32_t pixelSize;
+    int64_t index[MaxDimension];
+    uint64_t size[MaxDimension];
+    uint64_t tileSize[MaxDimension];
+    double spacing[MaxDimension];
+    double origin[MaxDimension];
+    double direction[MaxDimension * MaxDimension];
+  };
+
+  struct TileEntry {
+    uint64_t offset;
+    uint64_t compressedSize;
+  };
+
+  inline bool IsTiledVolume(const string& fileName)
+  {
+    return fileName.size() >= Extension.size() &&
+           fileName.compare(fileName.size() - Extension.size(), Extension.size(), Extension) == 0;
+  }
+
+  // number of tiles along dimension d
+  inline uint64_t TilesAlong(const Header& header, unsigned int d)
+  {
+    return ( header.size[d] + header.tileSize[d] - 1 ) / header.tileSize[d];
+  }
+
+  inline uint64_t NumberOfTiles(const Header& header)
+  {
+    uint64_t n = 1;
+    for(unsigned int d=0; d<header.dimension; ++d) n *= TilesAlong(header, d);
+    return n;
+  }
+
+  template <typename ImageType>
+  typename ImageType::RegionType TileRegion(const Header& header, uint64_t tile)
+  {
+    typename ImageType::RegionType region;
+    for(unsigned int d=0; d<ImageType::ImageDimension; ++d)
+    {
+      const uint64_t t = tile % TilesAlong(header, d);
+      tile /= TilesAlong(header, d);
+      const uint64_t begin = t * header.tileSize[d];
+      region.SetIndex(d, header.index[d] + static_cast< int64_t >(begin));
+      region.SetSize(d, min(header.tileSize[d], header.size[d] - begin));
+    }
+    return region;
+  }
+
+  // Calls copy(tileOffset, imageOffset, length) for each run of pixels along x
+  // shared by a tile and an image's buffered region, with offsets in pixels.
+  template <typename ImageType, typename CopyType>
+  void ForEachRow(const ImageType *image, const typename ImageType::RegionType& tileRegion, CopyType& copy)
+  {
+    typename ImageType::RegionType overlap = tileRegion;
+    if( !overlap.Crop( image->GetBufferedRegion() ) ) return;
+
+    const unsigned long length = overlap.GetSize()[0];
+    typename ImageType::RegionType rowStarts = overlap;
+    rowStarts.SetSize(0, 1);
+
+    for(itk::ImageRegionConstIteratorWithIndex< ImageType > it(image, rowStarts); !it.IsAtEnd(); ++it)
+    {
+      const typename ImageType::IndexType& index = it.GetIndex();
+      uint64_t tileOffset = 0, stride = 1;
+      for(unsigned int d=0; d<ImageType::ImageDimension; ++d)
+      {
+        tileOffset += ( index[d] - tileRegion.GetIndex()[d] ) * stride;
+        stride *= tileRegion.GetSize()[d];
+      }
+      copy(tileOffset, image->ComputeOffset(index), length);
+    }
+  }
+
+  template <typename ImageType>
+  struct CompressTiles {
+    typedef typename ImageType::PixelType PixelType;
+
+    const ImageType *image;
+    const Header& header;
+    int compressionLevel;
+    vector< vector< char > > tiles;
+
+    CompressTiles(const ImageType *i, const Header& h, int level):
+    image(i), header(h), compressionLevel(level), tiles(NumberOfTiles(h)) {}
+
+    struct CopyFromImage {
+      const PixelType *source;
+      PixelType *tile;
+      void operator()(uint64_t tileOffset, uint64_t imageOffset, unsigned long length)
+      {
+        memcpy(tile + tileOffset, source + imageOffset, length * sizeof(PixelType));
+      }
+    };
+
+    void operator()(unsigned int t)
+    {
+      const typename ImageType::RegionType region = TileRegion< ImageType >(header, t);
+      vector< PixelType > pixels(region.GetNumberOfPixels());
+      CopyFromImage copy = { image->GetBufferPointer(), &pixels[0] };
+      ForEachRow(image, region, copy);
+
+      const uLong sourceLength = pixels.size() * sizeof(PixelType);
+      uLongf compressedLength = compressBound(sourceLength);
+      tiles[t].resize(compressedLength);
+      if( compress2(reinterpret_cast< Bytef* >(&tiles[t][0]), &compressedLength,
+                    reinterpret_cast< const Bytef* >(&pixels[0]), sourceLength, compressionLevel) != Z_OK )
+      {
+        cerr << "Couldn't compress tile " << t << "." << endl;
+        exit(EXIT_FAILURE);
+      }
+      tiles[t].resize(compressedLength);
+    }
+  };
+
+  template <typename ImageType>
+  struct DecompressTiles {
+    typedef typename ImageType::PixelType PixelType;
+
+    ImageType *image;
+    const Header& header;
+    const vector< uint64_t >& tileNumbers;
+    const vector< vector< char > >& tiles;
+
+    DecompressTiles(ImageType *i, const Header& h, const vector< uint64_t >& n, const vector< vector< char > >& t):
+    image(i), header(h), tileNumbers(n), tiles(t) {}
+
+    struct CopyToImage {
+      const PixelType *tile;
+      PixelType *destination;
+      void operator()(uint64_t tileOffset, uint64_t imageOffset, unsigned long length)
+      {
+        memcpy(destination + imageOffset, tile + tileOffset, length * sizeof(PixelType));
+      }
+    };
+
+    void operator()(unsigned int i)
+    {
+      const typename ImageType::RegionType region = TileRegion< ImageType >(header, tileNumbers[i]);
+      vector< PixelType > pixels(region.GetNumberOfPixels());
+
+      uLongf length = pixels.size() * sizeof(PixelType);
+      if( uncompress(reinterpret_cast< Bytef* >(&pixels[0]), &length,
+                     reinterpret_cast< const Bytef* >(&tiles[i][0]), tiles[i].size()) != Z_OK ||
+          length != pixels.size() * sizeof(PixelType) )
+      {
+        cerr << "Couldn't decompress tile " << tileNumbers[i] << "." << endl;
+        exit(EXIT_FAILURE);
+      }
+
+      CopyToImage copy = { &pixels[0], image->GetBufferPointer() };
+      ForEachRow(image, region, copy);
+    }
+  };
+
+  // tileSize is the edge length of the tiles, in pixels, along every dimension
+  template <typename ImageType>
+  void Write(const ImageType *image, const string& fileName,
+             unsigned int tileSize = 64, int compressionLevel = Z_DEFAULT_COMPRESSION, unsigned int numberOfThreads = 0)
+  {
+    const typename ImageType::RegionType& region = image->GetLargestPossibleRegion();
+    if( image->GetBufferedRegion() != region || region.GetNumberOfPixels() == 0 )
+    {
+      cerr << "Couldn't write " << fileName << ": only whole, non-empty images can be tiled." << endl;
+      exit(EXIT_FAILURE);
+    }
+    if( ImageType::ImageDimension > MaxDimension )
+    {
+      cerr << "Couldn't write " << fileName << ": tiled volumes have at most " << MaxDimension << " dimensions." << endl;
+      exit(EXIT_FAILURE);
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.dimension = ImageType::ImageDimension;
+    header.pixelSize = sizeof(typename ImageType::PixelType);
+    for(unsigned int d=0; d<ImageType::ImageDimension; ++d)
+    {
+      header.index[d] = region.GetIndex()[d];
+      header.size[d] = region.GetSize()[d];
+      header.tileSize[d] = tileSize;
+      header.spacing[d] = image->GetSpacing()[d];
+      header.origin[d] = image->GetOrigin()[d];
+      for(unsigned int e=0; e<ImageType::ImageDimension; ++e)
+      {
+        header.direction[d * MaxDimension + e] = image->GetDirection()[d][e];
+      }
+    }
+
+    CompressTiles< ImageType > compressTiles(image, header, compressionLevel);
+    parallelFor(compressTiles.tiles.size(), compressTiles, numberOfThreads);
+
+    vector< TileEntry > entries(compressTiles.tiles.size());
+    uint64_t offset = sizeof(Header) + entries.size() * sizeof(TileEntry);
+    for(unsigned int t=0; t<entries.size(); ++t)
+    {
+      entries[t].offset = offset;
+      entries[t].compressedSize = compressTiles.tiles[t].size();
+      offset += entries[t].compressedSize;
+    }
+
+    ofstream file(fileName.c_str(), ios::binary);
+    file.write(reinterpret_cast< const char* >(&header), sizeof(Header));
+    if( !entries.empty() ) file.write(reinterpret_cast< const char* >(&entries[0]), entries.size() * sizeof(TileEntry));
+    for(unsigned int t=0; t<entries.size(); ++t)
+    {
+      if( !compressTiles.tiles[t].empty() ) file.write(&compressTiles.tiles[t][0], compressTiles.tiles[t].size());
+    }
+
+    if( !file )
+    {
+      cerr << "Couldn't write tiled volume " << fileName << "." << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  inline void ReadHeader(ifstream& file, const string& fileName, Header& header, vector< TileEntry >& entries)
+  {
+    file.read(reinterpret_cast< char* >(&header), sizeof(Header));
+    if( !file || memcmp(header.magic, Magic, sizeof(Magic)) != 0 )
+    {
+      cerr << fileName << " is not a tiled volume." << endl;
+      exit(EXIT_FAILURE);
+    }
+
+    entries.resize(NumberOfTiles(header));
+    if( !entries.empty() ) file.read(reinterpret_cast< char* >(&entries[0]), entries.size() * sizeof(TileEntry));
+    if( !file )
+    {
+      cerr << "Couldn't read the tile index of " << fileName << "." << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // the image's extent and geometry, without any pixels
+  template <typename ImageType>
+  typename ImageType::Pointer ReadInformation(const string& fileName)
+  {
+    ifstream file(fileName.c_str(), ios::binary);
+    Header header;
+    vector< TileEntry > entries;
+    ReadHeader(file, fileName, header, entries);
+
+    if( header.dimension != ImageType::ImageDimension || header.pixelSize != sizeof(typename ImageType::PixelType) )
+    {
+      cerr << fileName << " has dimension " << header.dimension << " and " << header.pixelSize << " byte pixels, "
+           << "not dimension " << ImageType::ImageDimension << " and " << sizeof(typename ImageType::PixelType) << " byte pixels." << endl;
+      exit(EXIT_FAILURE);
+    }
+
+    typename ImageType::Pointer image = ImageType::New();
+    typename ImageType::RegionType region;
+    typename ImageType::SpacingType spacing;
+    typename ImageType::PointType origin;
+    typename ImageType::DirectionType direction;
+    for(unsigned int d=0; d<ImageType::ImageDimension; ++d)
+    {
+      region.SetIndex(d, header.index[d]);
+      region.SetSize(d, header.size[d]);
+      spacing[d] = header.spacing[d];
+      origin[d] = header.origin[d];
+      for(unsigned int e=0; e<ImageType::ImageDimension; ++e)
+      {
+        direction[d][e] = header.direction[d * MaxDimension + e];
+      }
+    }
+    image->SetRegions(region);
+    image->SetSpacing(spacing);
+    image->SetOrigin(origin);
+    image->SetDirection(direction);
+
+    return image;
+  }
+
+  // Reads just the tiles that intersect region, into an image whose
+  // largest possible region is region, keeping its index and geometry
+  template <typename ImageType>
+  typename ImageType::Pointer ReadRegion(const string& fileName, const typename ImageType::RegionType& region, unsigned int numberOfThreads = 0)
+  {
+    typename ImageType::Pointer image = ReadInformation< ImageType >(fileName);
+    if( !image->GetLargestPossibleRegion().IsInside(region) )
+    {
+      cerr << "Region " << region << " is outside " << fileName << "." << endl;
+      exit(EXIT_FAILURE);
+    }
+    image->SetRegions(region);
+    image->Allocate();
+
+    ifstream file(fileName.c_str(), ios::binary);
+    Header header;
+    vector< TileEntry > entries;
+    ReadHeader(file, fileName, header, entries);
+
+    // read the compressed tiles serially, then decompress them in parallel
+    vector< uint64_t > tileNumbers;
+    for(uint64_t t=0; t<entries.size(); ++t)
+    {
+      typename ImageType::RegionType tileRegion = TileRegion< ImageType >(header, t);
+      if( tileRegion.Crop(region) ) tileNumbers.push_back(t);
+    }
+
+    vector< vector< char > > tiles(tileNumbers.size());
+    for(unsigned int i=0; i<tileNumbers.size(); ++i)
+    {
+      const TileEntry& entry = entries[tileNumbers[i]];
+      tiles[i].resize(entry.compressedSize);
+      file.seekg(entry.offset);
+      if( entry.compressedSize > 0 ) file.read(&tiles[i][0], entry.compressedSize);
+    }
+    if( !file )
+    {
+      cerr << "Couldn't read the tiles of " << fileName << "." << endl;
+      exit(EXIT_FAILURE);
+    }
+
+    DecompressTiles< ImageType > decompressTiles(image, header, tileNumbers, tiles);
+    parallelFor(tileNumbers.size(), decompressTiles, numberOfThreads);
+
+    return image;
+  }
+
+  template <typename ImageType>
+  typename ImageType::Pointer Read(const string& fileName, unsigned int numberOfThreads = 0)
+  {
+    return ReadRegion< ImageType >(fileName, ReadInformation< ImageType >(fileName)->GetLargestPossibleRegion(), numberOfThreads);
+  }
+}
+
+#endif
@@ -0,0 +1,191 @@
+// Diffusion smoothing of a series of slice transforms.
+// Each slice is diffused toward its neighbours based on the transforms
+// relating adjacent pairs of slices, and the result composed with
+// the slice's current transform.
+
+#ifndef TRANSFORMDIFFUSION_HPP_
+#define TRANSFORMDIFFUSION_HPP_
+
+#include <assert.h>
+
+#include "itkCenteredAffineTransform.h"
+
+#include "TransformSeries.hpp"
+#include "ParallelFor.hpp"
+
+using namespace std;
+
+namespace TransformDiffusion {
+  typedef itk::CenteredAffineTransform< double, 2 > TransformType;
+  typedef vector< TransformType::Pointer > TransformVectorType;
+
+  // basenames of the n+1 slices related by n pair transforms named e.g. 0001_0002
+  vector< string > SliceBasenames(const vector< string >& pairBasenames)
+  {
+    vector< string > sliceBasenames;
+    if(pairBasenames.empty()) return sliceBasenames;
+
+    for(unsigned int i=0; i<pairBasenames.size(); ++i)
+    {
+      sliceBasenames.push_back(pairBasenames[i].substr(0,4));
+      // make sure two transforms share the same slice
+      if(i > 0) assert(pairBasenames[i-1].substr(5,4) == sliceBasenames[i]);
+    }
+    sliceBasenames.push_back(pairBasenames.back().substr(5,4));
+
+    return sliceBasenames;
+  }
+
+  // linear interpolation of matrix and offset, from a (alpha = 0) to b (alpha = 1)
+  TransformType::Pointer interpolateTransforms(TransformType::Pointer a, TransformType::Pointer b, double alpha)
+  {
+    // extract matrices and offsets
+    TransformType::MatrixType M_a = a->GetMatrix();
+    TransformType::MatrixType M_b = b->GetMatrix();
+    TransformType::OffsetType O_a = a->GetOffset();
+    TransformType::OffsetType O_b = b->GetOffset();
+
+    // construct new transform from linear interpolation of parameters
+    TransformType::MatrixType M_c = M_a * (1 - alpha) + M_b * alpha;
+    TransformType::OffsetType O_c = O_a * (1 - alpha) + O_b * alpha;
+
+    TransformType::Pointer c = TransformType::New();
+    c->SetMatrix(M_c);
+    c->SetOffset(O_c);
+
+    return c;
+  }
+
+  // Diffusion transform for slice i of the n+1 slices related by n pair transforms.
+  // Middle slices diffuse toward the mean of their two neighbours. Since the boundary slices
+  // are just as likely to contain transformational noise, they are not fixed,
+  // but instead diffuse toward their single neighbour, analagously to
+  // zero-Neumann boundary conditions
+  TransformType::Pointer computeDiffusionTransform(const TransformVectorType& pairTransforms, unsigned int i, double alpha)
+  {
+    const unsigned int n = pairTransforms.size();
+    assert(n > 0 && i <= n);
+
+    TransformType::Pointer identity = TransformType::New();
+
+    if(i == 0)
+    {
+      TransformType::Pointer aboveBottomTransform = pairTransforms[0];
+      return interpolateTransforms(identity, aboveBottomTransform, alpha);
+    }
+
+    TransformType::Pointer belowTransform = TransformType::New();
+    pairTransforms[i-1]->GetInverse(belowTransform);
+
+    if(i == n)
+    {
+      return interpolateTransforms(identity, belowTransform, alpha);
+    }
+
+    TransformType::Pointer aboveTransform = pairTransforms[i];
+    TransformType::Pointer meanTransform  = interpolateTransforms(belowTransform, aboveTransform, 0.5);
+    // interpolate by alpha from identity transform to meanTransform
+    return interpolateTransforms(identity, meanTransform, 2 * alpha);
+  }
+
+  // Runs diffusion iterations entirely in memory. The pair transforms are only
+  // registered once; after each iteration they are updated to the residual
+  // misalignment left by the diffusion transforms, p'[i] = d[i]^-1 o p[i] o d[i+1],
+  // i.e. what re-registering the adjusted pairs would recover.
+  class Solver {
+  public:
+    Solver(const TransformVectorType& pairTransforms,
+           const TransformSeries::ComposableTransformVectorType& initialTransforms,
+           const itk::Vector< double, 2 >& roiTranslation,
+           double alpha):
+    m_pairTransforms(pairTransforms),
+    m_diffusionTransforms(initialTransforms.size()),
+    m_adjustedTransforms(initialTransforms.size()),
+    m_roiTranslation(roiTranslation),
+    m_alpha(alpha),
+    m_iteration(0),
+    m_numberOfThreads(0)
+    {
+      assert(pairTransforms.size() + 1 == initialTransforms.size());
+      for(unsigned int i=0; i<initialTransforms.size(); ++i)
+      {
+        m_adjustedTransforms[i] = TransformSeries::Copy(initialTransforms[i]);
+      }
+    }
+
+    // 0 uses ITK's global default
+    void SetNumberOfThreads(unsigned int numberOfThreads) { m_numberOfThreads = numberOfThreads; }
+
+    void Iterate()
+    {
+      // diffusion and adjustment of each slice only depends on the previous iteration
+      DiffuseSlice diffuseSlice(*this);
+      parallelFor(m_adjustedTransforms.size(), diffuseSlice, m_numberOfThreads);
+
+      // ...and so do the new pair transforms, once all the diffusion transforms are known
+      TransformVectorType newPairTransforms(m_pairTransforms.size());
+      UpdatePair updatePair(*this, newPairTransforms);
+      parallelFor(m_pairTransforms.size(), updatePair, m_numberOfThreads);
+      m_pairTransforms = newPairTransforms;
+
+      ++m_iteration;
+    }
+
+    void Iterate(unsigned int numberOfIterations)
+    {
+      for(unsigned int k=0; k<numberOfIterations; ++k) Iterate();
+    }
+
+    unsigned int GetIteration() const { return m_iteration; }
+
+    const TransformVectorType& GetPairTransforms() const { return m_pairTransforms; }
+
+    // diffusion transforms of the last iteration
+    const TransformVectorType& GetDiffusionTransforms() const { return m_diffusionTransforms; }
+
+    const TransformSeries::AffineTransformVectorType& GetAdjustedTransforms() const { return m_adjustedTransforms; }
+
+  private:
+    struct DiffuseSlice {
+      Solver& solver;
+      DiffuseSlice(Solver& s): solver(s) {}
+
+      void operator()(unsigned int i)
+      {
+        solver.m_diffusionTransforms[i] = computeDiffusionTransform(solver.m_pairTransforms, i, solver.m_alpha);
+        solver.m_adjustedTransforms[i] = TransformSeries::ComposeAdjusted(solver.m_adjustedTransforms[i],
+                                                                          solver.m_diffusionTransforms[i],
+                                                                          solver.m_roiTranslation);
+      }
+    };
+
+    struct UpdatePair {
+      Solver& solver;
+      TransformVectorType& newPairTransforms;
+      UpdatePair(Solver& s, TransformVectorType& p): solver(s), newPairTransforms(p) {}
+
+      void operator()(unsigned int i)
+      {
+        TransformType::Pointer inverseBelow = TransformType::New();
+        solver.m_diffusionTransforms[i]->GetInverse(inverseBelow);
+
+        TransformType::Pointer pair = TransformType::New();
+        pair->SetIdentity();
+        pair->Compose(solver.m_diffusionTransforms[i+1]);
+        pair->Compose(solver.m_pairTransforms[i]);
+        pair->Compose(inverseBelow);
+        newPairTransforms[i] = pair;
+      }
+    };
+
+    TransformVectorType m_pairTransforms;
+    TransformVectorType m_diffusionTransforms;
+    TransformSeries::AffineTransformVectorType m_adjustedTransforms;
+    itk::Vector< double, 2 > m_roiTranslation;
+    double m_alpha;
+    unsigned int m_iteration;
+    unsigned int m_numberOfThreads;
+  };
+}
+
+#endif
@@ -0,0 +1,124 @@
+// Composition of whole series of 2D linear transforms in memory.
+// Each series is read from disk once, composed with O(n) running products
+// and written back out in one pass.
+
+#ifndef TRANSFORMSERIES_HPP_
+#define TRANSFORMSERIES_HPP_
+
+#include <assert.h>
+
+#include "itkMatrixOffsetTransformBase.h"
+#include "itkAffineTransform.h"
+
+#include "IOHelpers.hpp"
+
+using namespace std;
+
+namespace TransformSeries {
+  // TranslationTransform also has a Compose() interface, but only with other TranslationTransforms
+  typedef itk::MatrixOffsetTransformBase< double, 2, 2 > ComposableTransformType;
+  typedef itk::AffineTransform< double, 2 > AffineTransformType;
+  typedef vector< ComposableTransformType::Pointer > ComposableTransformVectorType;
+  typedef vector< AffineTransformType::Pointer > AffineTransformVectorType;
+
+  // read every transform in paths, checking that each is of the right dynamic type
+  ComposableTransformVectorType Read(const vector< string >& paths)
+  {
+    ComposableTransformVectorType transforms;
+
+    for(unsigned int i=0; i<paths.size(); ++i)
+    {
+      itk::TransformBase::Pointer bpTransform = readTransform(paths[i]);
+      ComposableTransformType::Pointer transform = dynamic_cast< ComposableTransformType* >( bpTransform.GetPointer() );
+      assert( transform );
+      transforms.push_back( transform );
+    }
+
+    return transforms;
+  }
+
+  template <typename TransformVectorType>
+  void Write(const TransformVectorType& transforms, const vector< string >& paths)
+  {
+    assert( transforms.size() == paths.size() );
+
+    for(unsigned int i=0; i<transforms.size(); ++i)
+    {
+      writeTransform(transforms[i], paths[i]);
+    }
+  }
+
+  AffineTransformType::Pointer Copy(const ComposableTransformType *transform)
+  {
+    AffineTransformType::Pointer copy = AffineTransformType::New();
+    copy->SetMatrix( transform->GetMatrix() );
+    copy->SetOffset( transform->GetOffset() );
+    return copy;
+  }
+
+  // Compose()'s pre argument, for reference:
+  // If the argument pre is true (default false), then other is precomposed with self; that is, the resulting transformation consists of first
+  // applying other to the source, followed by self. If pre is false or omitted, then other is post-composed with self; that is the resulting
+  // transformation consists of first applying self to the source, followed by other. This updates the Translation based on current center.
+
+  // banana[i] applies the pair transforms from (n-1)->(n-2) down to i->(i-1),
+  // followed by original[i]. Rather than recomposing the whole tail for every i,
+  // a single running product of the pair transforms is extended by one each step,
+  // which performs exactly the same sequence of compositions as doing it from scratch.
+  AffineTransformVectorType ComposeBanana(const ComposableTransformVectorType& originals,
+                                          const ComposableTransformVectorType& adjustments)
+  {
+    assert( adjustments.size() + 1 == originals.size() );
+
+    AffineTransformVectorType bananas( originals.size() );
+
+    AffineTransformType::Pointer tail = AffineTransformType::New();
+    tail->SetIdentity();
+
+    for(int i=originals.size()-1; i >= 0; --i)
+    {
+      if( i < (int)adjustments.size() )
+      {
+        tail->Compose( adjustments[i] );
+      }
+
+      bananas[i] = Copy( tail );
+      bananas[i]->Compose( originals[i] );
+    }
+
+    return bananas;
+  }
+
+  // adjusted[i] applies diffusion[i] in the frame translated by roiTranslation,
+  // followed by original[i]
+  AffineTransformType::Pointer ComposeAdjusted(const ComposableTransformType *original,
+                                               const ComposableTransformType *diffusion,
+                                               const itk::Vector< double, 2 >& roiTranslation)
+  {
+    AffineTransformType::Pointer adjusted = AffineTransformType::New();
+    adjusted->SetIdentity();
+    adjusted->Translate(-roiTranslation);
+    adjusted->Compose(diffusion);
+    adjusted->Translate(roiTranslation);
+    adjusted->Compose(original);
+    return adjusted;
+  }
+
+  AffineTransformVectorType ComposeAdjusted(const ComposableTransformVectorType& originals,
+                                            const ComposableTransformVectorType& diffusions,
+                                            const itk::Vector< double, 2 >& roiTranslation)
+  {
+    assert( originals.size() == diffusions.size() );
+
+    AffineTransformVectorType adjusted;
+    for(unsigned int i=0; i<originals.size(); ++i)
+    {
+      adjusted.push_back( ComposeAdjusted(originals[i], diffusions[i], roiTranslation) );
+    }
+
+    return adjusted;
+  }
+
+}
+
+#endif
@@ -6,9 +6,11 @@
 
 #include "boost/program_options.hpp"
 
-#include "itkExtractImageFilter.h"
+#include "itkImageIOFactory.h"
+#include "itkSimpleFastMutexLock.h"
 
 #include "IOHelpers.hpp"
+#include "ParallelFor.hpp"
 #include "ScaleImages.hpp"
 
 namespace po = boost::program_options;
@@ -20,7 +22,6 @@ public:
   // typedefs
   typedef itk::Image< PixelType, 3 > VolumeType;
   typedef itk::Image< PixelType, 2 > SliceType;
-  typedef itk::ExtractImageFilter< VolumeType, SliceType > SplitterType;
   
   // constructors
   VolumeSplitter(po::variables_map vm);
@@ -32,7 +33,39 @@ public:
   void Split();
   
 private:
-  void ExtractAndSaveSlice(unsigned int n);
+  // Saves slices in parallel. Worker w saves every workers'th slice from
+  // the w'th, copying each into the same slice buffer.
+  struct SaveSlices {
+    VolumeSplitter *splitter;
+    const vector< unsigned int >& slices;
+    unsigned int workers;
+    
+    SaveSlices(VolumeSplitter *s, const vector< unsigned int >& sl, unsigned int w):
+    splitter(s), slices(sl), workers(w) {}
+    
+    void operator()(unsigned int w)
+    {
+      typename SliceType::Pointer slice = SliceType::New();
+      for(unsigned int i=w; i<slices.size(); i+=workers)
+      {
+        splitter->ExtractAndSaveSlice(slices[i], slice);
+      }
+    }
+  };
+  
+  void ExtractAndSaveSlice(unsigned int n, SliceType *slice);
+  
+  // copies sliceRegion of volume's buffer into slice, reallocating it only if
+  // its size changes, with the geometry ExtractImageFilter gives when
+  // collapsing the direction to identity
+  void CopySlice(const VolumeType *volume, const typename VolumeType::RegionType& sliceRegion, SliceType *slice);
+  
+  // the single slice n, as a region of the volume
+  typename VolumeType::RegionType GetSliceRegion(unsigned int n);
+  
+  string GetOutputFile(unsigned int n);
+  
+  void ShrinkSpacingsForLatex(SliceType *slice);
   
   // helper methods
   unsigned int GetNumberOfSlices()
@@ -45,11 +78,17 @@ private:
     return m_vm["sliceDimension"].template as<unsigned int>();
   }
   
+  string GetInputFile()
+  {
+    return m_vm["inputFile"].template as<string>();
+  }
+  
   // instance variables
   po::variables_map m_vm;
+  // only holds pixels once the whole volume is needed, and is then only read
   typename VolumeType::Pointer m_volume;
-  typename SplitterType::Pointer m_splitter;
   vector< unsigned int > m_slices;
+  itk::SimpleFastMutexLock m_outputLock;
   
 };
 
@@ -57,23 +96,8 @@ template <typename PixelType>
 VolumeSplitter< PixelType >::VolumeSplitter(po::variables_map vm):
   m_vm(vm)
 {
-  // read volume
-  cerr << "Reading volume...";
-  m_volume = readImage<VolumeType>(m_vm["inputFile"].template as<string>());
-  cerr << "done." << endl;
-  
-  // shrink image spacings so that latex can fit them on a page
-  if(vm["latex"].template as<bool>())
-  {
-    cerr << "spacings before: " << m_volume->GetSpacing() << endl;
-    m_volume->SetSpacing( m_volume->GetSpacing() / 100 );
-    cerr << "spacings after:  " << m_volume->GetSpacing() << endl;
-  }
-  
-  // set up splitter
-  m_splitter = SplitterType::New();
-  m_splitter->SetInput( m_volume );
-  m_splitter->SetDirectionCollapseToIdentity();
+  // read the volume's extent, leaving its pixels until it's known which slices are needed
+  m_volume = readImageInformation<VolumeType>(GetInputFile());
   
   // add slices if specified
   if(vm.count("slice"))
@@ -92,58 +116,129 @@ void VolumeSplitter< PixelType >::AddSlice(unsigned int n)
 template <typename PixelType>
 void VolumeSplitter< PixelType >::Split()
 {
-  // if slices are explicitly specified,
-  // only generate those ones
-  if(m_slices.size())
-  {
-    for(vector<unsigned int>::iterator it=m_slices.begin(); it != m_slices.end(); ++it)
-    {
-      ExtractAndSaveSlice(*it);
-    }
-  }
-  else
+  // if slices are explicitly specified, only generate those ones,
+  // reading each on its own as far as the volume's format allows
+  vector< unsigned int > slices = m_slices;
+  if(slices.empty())
   {
-    // generate all slices
+    // generating all slices needs the whole volume anyway, so read it in one go
+    cerr << "Reading volume...";
+    m_volume = readImage<VolumeType>(GetInputFile());
+    cerr << "done." << endl;
+    
     for(unsigned int i=0; i<GetNumberOfSlices(); ++i) {
-      ExtractAndSaveSlice(i);
+      slices.push_back(i);
     }
   }
+  
+  // register the image IO factories before any threads need them
+  itk::ImageIOFactory::CreateImageIO( GetOutputFile(0).c_str(), itk::ImageIOFactory::WriteMode );
+  
+  unsigned int workers = m_vm.count("threads") ? m_vm["threads"].template as<unsigned int>() : 0;
+  if(workers == 0) workers = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  if(workers > slices.size()) workers = slices.size();
+  
+  SaveSlices saveSlices(this, slices, workers);
+  parallelFor(workers, saveSlices, workers);
 }
 
 template <typename PixelType>
-void VolumeSplitter< PixelType >::ExtractAndSaveSlice(unsigned int n)
+void VolumeSplitter< PixelType >::ExtractAndSaveSlice(unsigned int n, SliceType *slice)
 {
-  cerr << "slice " << setw(4) << n << ": ";
-
-  // set up extraction region
-  typename VolumeType::SizeType size = m_volume->GetLargestPossibleRegion().GetSize();
-  size[GetSliceDimension()] = 0;
+  typename VolumeType::RegionType sliceRegion = GetSliceRegion(n);
   
-  typename VolumeType::IndexType index = {{0, 0, 0}};
+  // either the whole volume, or the slice read on its own
+  if(m_volume->GetBufferPointer())
+  {
+    CopySlice(m_volume, sliceRegion, slice);
+  }
+  else
+  {
+    typename VolumeType::Pointer volume = readImageRegion<VolumeType>(GetInputFile(), sliceRegion, 1);
+    CopySlice(volume, sliceRegion, slice);
+  }
   
-  typename VolumeType::RegionType sliceRegion;
-  sliceRegion.SetSize( size );
-  sliceRegion.SetIndex( index );
+  // shrink image spacings so that latex can fit them on a page
+  if(m_vm["latex"].template as<bool>())
+  {
+    ShrinkSpacingsForLatex(slice);
+  }
   
-  // Set the z-coordinate of the slice to be extracted
-  sliceRegion.SetIndex(GetSliceDimension(), n);
+  // write slice
+  writeImage< SliceType >(slice, GetOutputFile(n));
   
-  m_splitter->SetExtractionRegion( sliceRegion );
+  m_outputLock.Lock();
+  cerr << "slice " << setw(4) << n << ": done." << endl;
+  m_outputLock.Unlock();
+}
+
+template <typename PixelType>
+void VolumeSplitter< PixelType >::CopySlice(const VolumeType *volume, const typename VolumeType::RegionType& sliceRegion, SliceType *slice)
+{
+  // the volume's axes that lie in the slice
+  unsigned int axes[2];
+  for(unsigned int d=0, i=0; d<3; ++d)
+  {
+    if(d != GetSliceDimension()) axes[i++] = d;
+  }
   
-  // split volume
-  try
+  typename SliceType::RegionType region;
+  typename SliceType::SpacingType spacing;
+  typename SliceType::PointType origin;
+  typename SliceType::DirectionType direction;
+  direction.SetIdentity();
+  for(unsigned int i=0; i<2; ++i)
   {
-    cerr << "extracting slice...";
-    m_splitter->Update();
+    region.SetIndex(i, sliceRegion.GetIndex(axes[i]));
+    region.SetSize(i, sliceRegion.GetSize(axes[i]));
+    spacing[i] = volume->GetSpacing()[axes[i]];
+    origin[i] = volume->GetOrigin()[axes[i]];
   }
-  catch( itk::ExceptionObject & err )
+  
+  if(region != slice->GetBufferedRegion())
   {
-    std::cerr << "ExceptionObject caught while updating volume splitter." << std::endl;
-    cerr << err << endl;
-		exit(EXIT_FAILURE);
+    slice->SetRegions(region);
+    slice->Allocate();
   }
+  slice->SetSpacing(spacing);
+  slice->SetOrigin(origin);
+  slice->SetDirection(direction);
   
-  // write slice
+  // walk the volume's buffer along the slice's rows, which are contiguous
+  // unless the slices are perpendicular to x
+  const typename VolumeType::OffsetValueType *offsetTable = volume->GetOffsetTable();
+  const typename VolumeType::OffsetValueType columnStride = offsetTable[axes[0]], rowStride = offsetTable[axes[1]];
+  const PixelType *in = volume->GetBufferPointer() + volume->ComputeOffset(sliceRegion.GetIndex());
+  PixelType *out = slice->GetBufferPointer();
+  const unsigned int width = region.GetSize(0), height = region.GetSize(1);
+  for(unsigned int y=0; y<height; ++y, in+=rowStride, out+=width)
+  {
+    if(columnStride == 1)
+    {
+      copy(in, in + width, out);
+    }
+    else
+    {
+      for(unsigned int x=0; x<width; ++x) out[x] = in[x * columnStride];
+    }
+  }
+}
+
+template <typename PixelType>
+typename VolumeSplitter< PixelType >::VolumeType::RegionType VolumeSplitter< PixelType >::GetSliceRegion(unsigned int n)
+{
+  typename VolumeType::RegionType sliceRegion = m_volume->GetLargestPossibleRegion();
+  
+  // Set the z-coordinate of the slice to be extracted
+  sliceRegion.SetIndex(GetSliceDimension(), n);
+  sliceRegion.SetSize(GetSliceDimension(), 1);
+  
+  return sliceRegion;
+}
+
+template <typename PixelType>
+string VolumeSplitter< PixelType >::GetOutputFile(unsigned int n)
+{
   stringstream outputFile;
   outputFile << m_vm["outputDir"].template as<string>() << "/"
              // leading zeros
@@ -153,12 +248,13 @@ void VolumeSplitter< PixelType >::ExtractAndSaveSlice(unsigned int n)
              << n
              << "."
              << m_vm["outputExtension"].template as<string>();
-  
-  typename SliceType::Pointer outputSlice = m_splitter->GetOutput();
-  
-  cerr << "writing slice...";
-  writeImage< SliceType >(outputSlice, outputFile.str());
-  cerr << "done." << endl;
+  return outputFile.str();
+}
+
+template <typename PixelType>
+void VolumeSplitter< PixelType >::ShrinkSpacingsForLatex(SliceType *slice)
+{
+  slice->SetSpacing( slice->GetSpacing() / 100 );
 }
 
 #endif
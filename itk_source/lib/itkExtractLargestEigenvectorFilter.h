@@ -10,7 +10,12 @@
 namespace itk
 {
 /** \class ExtractLargestEigenvectorFilter
- * \brief Constructs a structure tensor for each voxel.
+ * \brief Scales the largest eigenvector of each tensor by its eigenvalue.
+ *
+ * By default the tensors, which must have float components, are solved in closed
+ * form, see LargestEigenvector.hpp, in tiles in parallel. SetClosedForm(false) uses ITK's general eigen-analysis
+ * for each voxel instead, which agrees to about 1e-5 of the eigenvalue except
+ * where the largest eigenvalue is repeated, and its eigenvector isn't unique.
  *
  * \ingroup ImageFilters
  */
@@ -21,7 +26,7 @@ public:
 	/** Standard class typedefs. */
   typedef typename TensorImage::PixelType TensorType;
 	typedef ExtractLargestEigenvectorFilter             Self;
-	typedef ImageToImageFilter< TensorImage, Image< FixedArray<float, TensorImage::ImageDimension>, TensorImage::ImageDimension> > Superclass;
+	typedef ImageToImageFilter< TensorImage, Image< CovariantVector<float, TensorImage::ImageDimension>, TensorImage::ImageDimension> > Superclass;
 	typedef SmartPointer< Self >        Pointer;
   typedef CovariantVector<float, TensorImage::ImageDimension > VectorType;
   typedef Image< VectorType, TensorImage::ImageDimension > VectorImageType;
@@ -32,10 +37,19 @@ public:
 	/** Run-time type information (and related methods). */
 	itkTypeMacro(ExtractLargestEigenvectorFilter, ImageToImageFilter);
   
+	itkSetMacro(ClosedForm, bool);
+	itkGetConstMacro(ClosedForm, bool);
+	itkBooleanMacro(ClosedForm);
+  
 protected:
-	ExtractLargestEigenvectorFilter(){}
+	ExtractLargestEigenvectorFilter()
+	{
+		m_ClosedForm=true;
+	}
 	~ExtractLargestEigenvectorFilter(){}
   
+	virtual void GenerateInputRequestedRegion();
+	virtual void EnlargeOutputRequestedRegion(DataObject *output);
 	virtual void GenerateData();
   
 	class ExtractLargestEigenvectorFunctor
@@ -58,6 +72,8 @@ protected:
 private:
 	ExtractLargestEigenvectorFilter(const Self &); //purposely not implemented
 	void operator=(const Self &);  //purposely not implemented
+
+	bool m_ClosedForm;
 };
 } //namespace ITK
 
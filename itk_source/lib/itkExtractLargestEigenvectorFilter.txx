@@ -3,14 +3,45 @@
 
 #include <itkUnaryFunctorImageFilter.h>
 #include "itkExtractLargestEigenvectorFilter.h"
+#include "LargestEigenvector.hpp"
 
 namespace itk
 {
 
+template< class TensorImage >
+void ExtractLargestEigenvectorFilter< TensorImage >
+::GenerateInputRequestedRegion()
+{
+	Superclass::GenerateInputRequestedRegion();
+
+	// the closed form solves the whole buffer
+	TensorImage *input = const_cast< TensorImage * >( this->GetInput() );
+	if( input ) input->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template< class TensorImage >
+void ExtractLargestEigenvectorFilter< TensorImage >
+::EnlargeOutputRequestedRegion(DataObject *output)
+{
+	Superclass::EnlargeOutputRequestedRegion(output);
+	output->SetRequestedRegionToLargestPossibleRegion();
+}
+
 template< class TensorImage >
 void ExtractLargestEigenvectorFilter< TensorImage >
 ::GenerateData()
 {
+	if( m_ClosedForm )
+	{
+		this->AllocateOutputs();
+		const TensorImage *input = this->GetInput();
+		LargestEigenvector::Solve< TensorImage::ImageDimension >(
+			reinterpret_cast< const float * >( input->GetBufferPointer() ),
+			reinterpret_cast< float * >( this->GetOutput()->GetBufferPointer() ),
+			input->GetBufferedRegion().GetNumberOfPixels(), this->GetNumberOfThreads() );
+		return;
+	}
+
 	typedef itk::UnaryFunctorImageFilter< TensorImage , VectorImageType, ExtractLargestEigenvectorFunctor > FilterType;
 	typename FilterType::Pointer filter=FilterType::New();
 	filter->SetInput(this->GetInput());
@@ -0,0 +1,93 @@
+// smooths a multi-channel image with a Gaussian, by default of sigma = shrink factor pixels,
+// and decimates it, computing smoothed values only at the output sample positions
+
+#ifndef __itkGaussianDownsampleImageFilter_h
+#define __itkGaussianDownsampleImageFilter_h
+
+#include <vector>
+#include <itkImageToImageFilter.h>
+
+namespace itk
+{
+/** \class GaussianDownsampleImageFilter
+ * \brief Fused separable Gaussian smoothing and decimation of a 2D image.
+ *
+ * Output pixel (i, j) is the Gaussian-weighted mean of the input around
+ * index (i * factor, j * factor), the same grid ShrinkImage resamples on.
+ * Each thread filters the input rows its output rows need along x, at the
+ * output columns only, into a ring of scratch rows that is reused as it moves
+ * down the image, and then combines those rows along y. No full-size intermediate
+ * is allocated, and only the input rows within the kernel's support are requested,
+ * so the filter streams.
+ *
+ * The kernel is truncated at 4 sigma and normalised, and edges are clamped.
+ * Pixels must be fixed arrays of channels, such as RGBPixel< unsigned char >.
+ *
+ * \ingroup ImageFilters
+ */
+template< class TImage >
+class GaussianDownsampleImageFilter:public ImageToImageFilter< TImage, TImage >
+{
+public:
+	/** Standard class typedefs. */
+	typedef GaussianDownsampleImageFilter       Self;
+	typedef ImageToImageFilter< TImage, TImage > Superclass;
+	typedef SmartPointer< Self >                 Pointer;
+
+	typedef TImage                                  ImageType;
+	typedef typename ImageType::PixelType           PixelType;
+	typedef typename PixelType::ComponentType       ComponentType;
+	typedef typename ImageType::RegionType          RegionType;
+	typedef typename ImageType::IndexType           IndexType;
+	typedef typename ImageType::SizeType            SizeType;
+
+	itkStaticConstMacro(Channels, unsigned int, PixelType::Length);
+
+	/** Method for creation through the object factory. */
+	itkNewMacro(Self);
+
+	/** Run-time type information (and related methods). */
+	itkTypeMacro(GaussianDownsampleImageFilter, ImageToImageFilter);
+
+	itkSetMacro(ShrinkFactor, unsigned int);
+	itkGetConstMacro(ShrinkFactor, unsigned int);
+
+	/** Sigma in input pixels, 0 meaning the shrink factor. */
+	itkSetMacro(Sigma, double);
+	itkGetConstMacro(Sigma, double);
+
+protected:
+	GaussianDownsampleImageFilter()
+	{
+		m_ShrinkFactor=1;
+		m_Sigma=0;
+	}
+	~GaussianDownsampleImageFilter(){}
+
+	virtual void GenerateOutputInformation();
+	virtual void GenerateInputRequestedRegion();
+	virtual void BeforeThreadedGenerateData();
+	virtual void ThreadedGenerateData(const RegionType& outputRegionForThread, ThreadIdType threadId);
+
+private:
+	GaussianDownsampleImageFilter(const Self &); //purposely not implemented
+	void operator=(const Self &);  //purposely not implemented
+
+	// filters input row y along x at the output columns of the thread's region
+	void FilterRow(long y, long firstColumn, unsigned int width, float *line, float *out) const;
+
+	double GetKernelSigma() const;
+	long GetRadius() const;
+
+	unsigned int m_ShrinkFactor;
+	double m_Sigma;
+	std::vector< float > m_Weights;
+};
+} //namespace ITK
+
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkGaussianDownsampleImageFilter.txx"
+#endif
+
+#endif // __itkGaussianDownsampleImageFilter_h
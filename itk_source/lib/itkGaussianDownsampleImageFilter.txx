@@ -0,0 +1,246 @@
+#ifndef __itkGaussianDownsampleImageFilter_txx
+#define __itkGaussianDownsampleImageFilter_txx
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <itkImageLinearIteratorWithIndex.h>
+#include <itkNumericTraits.h>
+#include "itkGaussianDownsampleImageFilter.h"
+
+namespace itk
+{
+
+// The vectorised loops read and write a whole register of 4 floats from the start
+// of a pixel's channels, so each scratch row has this much padding at its end
+static const unsigned int GaussianDownsamplePadding = 4;
+
+template< class TImage >
+double GaussianDownsampleImageFilter< TImage >
+::GetKernelSigma() const
+{
+	return m_Sigma > 0 ? m_Sigma : m_ShrinkFactor;
+}
+
+template< class TImage >
+long GaussianDownsampleImageFilter< TImage >
+::GetRadius() const
+{
+	return static_cast< long >( std::ceil( 4.0 * GetKernelSigma() ) );
+}
+
+template< class TImage >
+void GaussianDownsampleImageFilter< TImage >
+::GenerateOutputInformation()
+{
+	Superclass::GenerateOutputInformation();
+
+	const ImageType *input = this->GetInput();
+	ImageType *output = this->GetOutput();
+	if( !input ) return;
+
+	const RegionType& inputRegion = input->GetLargestPossibleRegion();
+
+	// output index 0 samples the first input pixel
+	IndexType index;
+	index.Fill(0);
+	SizeType size;
+	typename ImageType::SpacingType spacing;
+	for(unsigned int d=0; d<ImageType::ImageDimension; ++d)
+	{
+		size[d] = inputRegion.GetSize()[d] / m_ShrinkFactor;
+		spacing[d] = input->GetSpacing()[d] * m_ShrinkFactor;
+	}
+
+	typename ImageType::PointType origin;
+	input->TransformIndexToPhysicalPoint( inputRegion.GetIndex(), origin );
+
+	output->SetLargestPossibleRegion( RegionType( index, size ) );
+	output->SetSpacing( spacing );
+	output->SetOrigin( origin );
+}
+
+template< class TImage >
+void GaussianDownsampleImageFilter< TImage >
+::GenerateInputRequestedRegion()
+{
+	Superclass::GenerateInputRequestedRegion();
+
+	ImageType *input = const_cast< ImageType * >( this->GetInput() );
+	if( !input ) return;
+
+	const RegionType& outputRegion = this->GetOutput()->GetRequestedRegion();
+	const RegionType& inputLargestRegion = input->GetLargestPossibleRegion();
+	if( outputRegion.GetNumberOfPixels() == 0 ) return;
+
+	// only the input within the kernel's support of the requested samples
+	const long f = m_ShrinkFactor, r = GetRadius();
+	RegionType inputRegion;
+	for(unsigned int d=0; d<ImageType::ImageDimension; ++d)
+	{
+		const long start = inputLargestRegion.GetIndex()[d];
+		const long last  = start + static_cast< long >( inputLargestRegion.GetSize()[d] ) - 1;
+		const long first = outputRegion.GetIndex()[d];
+		const long end   = first + static_cast< long >( outputRegion.GetSize()[d] ) - 1;
+		const long begin = std::max( start + first * f - r, start );
+		const long stop  = std::min( start + end * f + r, last );
+		inputRegion.SetIndex( d, begin );
+		inputRegion.SetSize( d, stop - begin + 1 );
+	}
+
+	input->SetRequestedRegion( inputRegion );
+}
+
+template< class TImage >
+void GaussianDownsampleImageFilter< TImage >
+::BeforeThreadedGenerateData()
+{
+	// normalised Gaussian
+	const long r = GetRadius();
+	const double sigma = GetKernelSigma();
+	m_Weights.resize( 2 * r + 1 );
+
+	double total = 0;
+	for(long t=-r; t<=r; ++t)
+	{
+		total += m_Weights[t + r] = std::exp( -0.5 * t * t / ( sigma * sigma ) );
+	}
+	for(unsigned int t=0; t<m_Weights.size(); ++t) m_Weights[t] /= total;
+}
+
+template< class TImage >
+void GaussianDownsampleImageFilter< TImage >
+::FilterRow(long y, long firstColumn, unsigned int width, float *line, float *out) const
+{
+	const ImageType *input = this->GetInput();
+	const RegionType& largestRegion  = input->GetLargestPossibleRegion();
+	const RegionType& bufferedRegion = input->GetBufferedRegion();
+	const long f = m_ShrinkFactor, r = GetRadius(), taps = 2 * r + 1;
+	const long startX = largestRegion.GetIndex()[0], lastX = startX + static_cast< long >( largestRegion.GetSize()[0] ) - 1;
+	const long startY = largestRegion.GetIndex()[1], lastY = startY + static_cast< long >( largestRegion.GetSize()[1] ) - 1;
+
+	// the input row, with edges clamped, converted to float once
+	IndexType rowIndex;
+	rowIndex[0] = bufferedRegion.GetIndex()[0];
+	rowIndex[1] = std::min( std::max( y, startY ), lastY );
+	const PixelType *row = input->GetBufferPointer() + input->ComputeOffset( rowIndex );
+
+	const long firstX = startX + firstColumn * f - r;
+	const long lineWidth = ( width - 1 ) * f + taps;
+	for(long k=0; k<lineWidth; ++k)
+	{
+		const long x = std::min( std::max( firstX + k, startX ), lastX );
+		const PixelType& pixel = row[x - rowIndex[0]];
+		for(unsigned int c=0; c<Channels; ++c) line[k * Channels + c] = pixel[c];
+	}
+
+	// convolve at the output columns only
+	const float *weights = &m_Weights[0];
+	for(unsigned int i=0; i<width; ++i)
+	{
+		const float *in = line + i * f * Channels;
+#ifdef __SSE2__
+		if( Channels <= GaussianDownsamplePadding )
+		{
+			// all the channels of a pixel in one register
+			__m128 sum = _mm_setzero_ps();
+			for(long t=0; t<taps; ++t)
+			{
+				sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( weights[t] ), _mm_loadu_ps( in + t * Channels ) ) );
+			}
+			_mm_storeu_ps( out + i * Channels, sum );
+			continue;
+		}
+#endif
+		for(unsigned int c=0; c<Channels; ++c)
+		{
+			float sum = 0;
+			for(long t=0; t<taps; ++t) sum += weights[t] * in[t * Channels + c];
+			out[i * Channels + c] = sum;
+		}
+	}
+}
+
+template< class TImage >
+void GaussianDownsampleImageFilter< TImage >
+::ThreadedGenerateData(const RegionType& outputRegionForThread, ThreadIdType)
+{
+	const ImageType *input = this->GetInput();
+	ImageType *output = this->GetOutput();
+	if( outputRegionForThread.GetNumberOfPixels() == 0 ) return;
+
+	const long f = m_ShrinkFactor, r = GetRadius(), taps = 2 * r + 1;
+	const long startY = input->GetLargestPossibleRegion().GetIndex()[1];
+	const long firstColumn = outputRegionForThread.GetIndex()[0];
+	const unsigned int width = outputRegionForThread.GetSize()[0];
+	const unsigned int rowLength = width * Channels;
+	const unsigned int stride = rowLength + GaussianDownsamplePadding;
+
+	// scratch reused for every row of this thread's region:
+	// one input row, and a ring of rows filtered along x, keyed by input row
+	std::vector< float > line( ( ( width - 1 ) * f + taps ) * Channels + GaussianDownsamplePadding );
+	std::vector< float > ring( taps * stride );
+	std::vector< long > ringRows( taps, std::numeric_limits< long >::min() );
+	std::vector< float > sum( stride );
+
+	const ComponentType minimum = NumericTraits< ComponentType >::NonpositiveMin();
+	const ComponentType maximum = NumericTraits< ComponentType >::max();
+	const float rounding = NumericTraits< ComponentType >::is_integer ? 0.5f : 0.0f;
+
+	typedef ImageLinearIteratorWithIndex< ImageType > IteratorType;
+	IteratorType it( output, outputRegionForThread );
+	it.SetDirection(0);
+	it.GoToBegin();
+
+	for(; !it.IsAtEnd(); it.NextLine())
+	{
+		const long centre = startY + it.GetIndex()[1] * f;
+		std::fill( sum.begin(), sum.end(), 0.0f );
+
+		// combine the rows filtered along x, filtering any not yet in the ring
+		for(long t=0; t<taps; ++t)
+		{
+			const long y = centre - r + t;
+			const long slot = ( ( y % taps ) + taps ) % taps;
+			float *row = &ring[slot * stride];
+			if( ringRows[slot] != y )
+			{
+				FilterRow( y, firstColumn, width, &line[0], row );
+				ringRows[slot] = y;
+			}
+
+			const float weight = m_Weights[t];
+			unsigned int k = 0;
+#ifdef __SSE2__
+			const __m128 w = _mm_set1_ps( weight );
+			for(; k + 4 <= rowLength; k += 4)
+			{
+				_mm_storeu_ps( &sum[k], _mm_add_ps( _mm_loadu_ps( &sum[k] ), _mm_mul_ps( w, _mm_loadu_ps( row + k ) ) ) );
+			}
+#endif
+			for(; k<rowLength; ++k) sum[k] += weight * row[k];
+		}
+
+		for(unsigned int i=0; !it.IsAtEndOfLine(); ++i, ++it)
+		{
+			PixelType pixel;
+			for(unsigned int c=0; c<Channels; ++c)
+			{
+				const float value = sum[i * Channels + c];
+				if( value <= minimum )      pixel[c] = minimum;
+				else if( value >= maximum ) pixel[c] = maximum;
+				else                        pixel[c] = static_cast< ComponentType >( value + rounding );
+			}
+			it.Set( pixel );
+		}
+	}
+}
+
+}// end namespace
+
+#endif //__itkGaussianDownsampleImageFilter_txx
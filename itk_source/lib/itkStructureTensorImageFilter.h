@@ -1,6 +1,8 @@
 ﻿#ifndef __itkStructureTensorImageFilter_h
 #define __itkStructureTensorImageFilter_h
 
+#include <vector>
+#include <cmath>
 #include <itkImageToImageFilter.h>
 #include <itkSymmetricSecondRankTensor.h>
 
@@ -9,6 +11,25 @@ namespace itk
 /** \class StructureTensorImageFilter
  * \brief Constructs a structure tensor for each voxel.
  *
+ * The tensor is the outer product of the image's gradient, by central differences
+ * as GradientImageFilter's, smoothed by a Gaussian of Sigma, in physical units.
+ *
+ * By default this is fused: the image is cut into slabs along its last axis, one
+ * per thread, and each thread computes tensors for a plane at a time, smooths them
+ * within the plane in place, and keeps them in a ring of as many planes as the
+ * Gaussian is wide, from which the output planes are smoothed across. The fused
+ * path smooths with a normalised Gaussian truncated at 4 sigma and clamped edges,
+ * along the first axis only, as the original pipeline does, or along every axis
+ * with SmoothAllAxesOn(). Beyond the input and output, each thread holds a plane
+ * of scratch and the ring: a single plane, or when smoothing every axis
+ * 2*ceil(4*Sigma/spacing)+1 planes, for the spacing along the last axis, rather
+ * than full-size gradient and tensor images.
+ *
+ * SetFused(false) runs the original pipeline of ITK filters instead, which
+ * smooths with a single recursive Gaussian along the first axis only, whatever
+ * SmoothAllAxes, so reproduces earlier results; the fused path's results differ
+ * slightly from it, its Gaussian being truncated rather than recursive.
+ *
  * \ingroup ImageFilters
  */
 template< class TInputImage >
@@ -22,6 +43,11 @@ public:
 	typedef SmartPointer< Self >        Pointer;
 	typedef Image<TensorType, TInputImage::ImageDimension> OutputImageType;
 	typedef CovariantVector<float, TInputImage::ImageDimension> CVector;
+	typedef typename TInputImage::PixelType InputPixelType;
+	typedef typename TInputImage::RegionType RegionType;
+
+	itkStaticConstMacro(ImageDimension, unsigned int, TInputImage::ImageDimension);
+	itkStaticConstMacro(Components, unsigned int, TensorType::InternalDimension);
 
 	/** Method for creation through the object factory. */
 	itkNewMacro(Self);
@@ -31,14 +57,41 @@ public:
   
 	itkSetMacro(Sigma, double);
 	itkGetConstMacro(Sigma, const double);
+
+	itkSetMacro(Fused, bool);
+	itkGetConstMacro(Fused, bool);
+	itkBooleanMacro(Fused);
+
+	/** Whether the fused path smooths along every axis, rather than the first only. */
+	itkSetMacro(SmoothAllAxes, bool);
+	itkGetConstMacro(SmoothAllAxes, bool);
+	itkBooleanMacro(SmoothAllAxes);
+
+	/** The radius in pixels of the fused path's Gaussian of sigma pixels. */
+	static long GetKernelRadius(double sigma)
+	{
+		return sigma > 0 ? static_cast< long >( std::ceil( 4.0 * sigma ) ) : 0;
+	}
+
+	/** The number of input pixels either side of a region along an axis of
+	 * the given spacing that the fused path's output in it depends on: the
+	 * Gaussian's radius if that axis is smoothed, and one more for the gradient. */
+	static long GetHalo(double sigma, double spacing, bool smoothed)
+	{
+		return ( smoothed ? GetKernelRadius( sigma / spacing ) : 0 ) + 1;
+	}
   
 protected:
 	StructureTensorImageFilter()
 	{
 		m_Sigma=1.0;
+		m_Fused=true;
+		m_SmoothAllAxes=false;
 	}
 	~StructureTensorImageFilter(){}
   
+	virtual void GenerateInputRequestedRegion();
+	virtual void EnlargeOutputRequestedRegion(DataObject *output);
 	virtual void GenerateData();
   
 	class CovariantVectorToTensorFunctor
@@ -58,7 +111,32 @@ private:
 	StructureTensorImageFilter(const Self &); //purposely not implemented
 	void operator=(const Self &);  //purposely not implemented
 
+	// runs SmoothSlab on slabs of the output, one per thread
+	struct SmoothSlabs
+	{
+		Self *filter;
+		unsigned int numberOfSlabs;
+
+		void operator()(unsigned int slab);
+	};
+
+	void GenerateDataWithPipeline();
+
+	// the outer products of the gradients in plane p along the last axis
+	void ComputeTensors(long p, TensorType *plane) const;
+
+	// smooths plane along each of its axes in place
+	void SmoothPlane(TensorType *plane, TensorType *scratch) const;
+
+	// computes output planes [first, end) along the last axis
+	void SmoothSlab(long first, long end);
+
 	double m_Sigma;
+	bool m_Fused;
+	bool m_SmoothAllAxes;
+
+	// normalised Gaussian weights along each axis, a single tap if it isn't smoothed
+	std::vector< std::vector< float > > m_Weights;
 };
 } //namespace ITK
 
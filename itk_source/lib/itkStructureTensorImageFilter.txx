@@ -1,17 +1,260 @@
 ﻿#ifndef __itkStructureTensorImageFilter_txx
 #define __itkStructureTensorImageFilter_txx
 
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <itkGradientImageFilter.h>
 #include <itkRecursiveGaussianImageFilter.h>
 #include <itkUnaryFunctorImageFilter.h>
 #include "itkStructureTensorImageFilter.h"
+#include "ParallelFor.hpp"
 
 namespace itk
 {
 
+// out[k] = sum over t of weights[t] * lines[t][k]
+inline void StructureTensorWeightedSum(const float * const *lines, const std::vector< float >& weights, float *out, unsigned long length)
+{
+	const unsigned int taps = weights.size();
+	unsigned long k = 0;
+#ifdef __SSE2__
+	for(; k + 4 <= length; k += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for(unsigned int t=0; t<taps; ++t)
+		{
+			sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( weights[t] ), _mm_loadu_ps( lines[t] + k ) ) );
+		}
+		_mm_storeu_ps( out + k, sum );
+	}
+#endif
+	for(; k<length; ++k)
+	{
+		float sum = 0;
+		for(unsigned int t=0; t<taps; ++t) sum += weights[t] * lines[t][k];
+		out[k] = sum;
+	}
+}
+
+template< class TInputImage >
+void StructureTensorImageFilter< TInputImage >
+::GenerateInputRequestedRegion()
+{
+	Superclass::GenerateInputRequestedRegion();
+
+	// gradients and smoothing reach across the whole image
+	TInputImage *input = const_cast< TInputImage * >( this->GetInput() );
+	if( input ) input->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template< class TInputImage >
+void StructureTensorImageFilter< TInputImage >
+::EnlargeOutputRequestedRegion(DataObject *output)
+{
+	Superclass::EnlargeOutputRequestedRegion(output);
+	output->SetRequestedRegionToLargestPossibleRegion();
+}
+
 template< class TInputImage >
 void StructureTensorImageFilter< TInputImage >
 ::GenerateData()
+{
+	if( !m_Fused )
+	{
+		GenerateDataWithPipeline();
+		return;
+	}
+
+	this->AllocateOutputs();
+	const TInputImage *input = this->GetInput();
+	const RegionType& region = input->GetBufferedRegion();
+	if( region.GetNumberOfPixels() == 0 ) return;
+
+	// normalised Gaussians of sigma in each smoothed axis' pixels; a sigma
+	// of zero gives the other axes a single tap
+	m_Weights.resize( ImageDimension );
+	for(unsigned int d=0; d<ImageDimension; ++d)
+	{
+		const double sigma = d == 0 || m_SmoothAllAxes ? m_Sigma / input->GetSpacing()[d] : 0;
+		const long r = GetKernelRadius( sigma );
+		m_Weights[d].resize( 2 * r + 1 );
+
+		double total = 0;
+		for(long t=-r; t<=r; ++t)
+		{
+			total += m_Weights[d][t + r] = r ? std::exp( -0.5 * t * t / ( sigma * sigma ) ) : 1.0;
+		}
+		for(unsigned int t=0; t<m_Weights[d].size(); ++t) m_Weights[d][t] /= total;
+	}
+
+	// each slab recomputes the planes either side of it that its smoothing reaches,
+	// so slabs are as few as keep the threads busy
+	const unsigned int length = region.GetSize()[ImageDimension - 1];
+	SmoothSlabs smoothSlabs;
+	smoothSlabs.filter = this;
+	smoothSlabs.numberOfSlabs = std::min( this->GetNumberOfThreads(), length );
+	parallelFor( smoothSlabs.numberOfSlabs, smoothSlabs, smoothSlabs.numberOfSlabs );
+}
+
+template< class TInputImage >
+void StructureTensorImageFilter< TInputImage >
+::SmoothSlabs::operator()(unsigned int slab)
+{
+	const long length = filter->GetInput()->GetBufferedRegion().GetSize()[ImageDimension - 1];
+	filter->SmoothSlab( length * slab / numberOfSlabs, length * ( slab + 1 ) / numberOfSlabs );
+}
+
+template< class TInputImage >
+void StructureTensorImageFilter< TInputImage >
+::ComputeTensors(long p, TensorType *plane) const
+{
+	const TInputImage *input = this->GetInput();
+	const typename RegionType::SizeType& size = input->GetBufferedRegion().GetSize();
+	const unsigned int Last = ImageDimension - 1;
+
+	// central differences, one-sided at the edges, as GradientImageFilter's
+	// zero-flux boundary gives, in physical units
+	long strides[ImageDimension], index[ImageDimension];
+	float scales[ImageDimension];
+	unsigned long planePixels = 1;
+	for(unsigned int d=0; d<ImageDimension; ++d)
+	{
+		strides[d] = planePixels;
+		if( d < Last ) planePixels *= size[d];
+		scales[d] = 0.5 / input->GetSpacing()[d];
+		index[d] = 0;
+	}
+	index[Last] = p;
+
+	const typename TInputImage::DirectionType& direction = input->GetDirection();
+	bool identity = true;
+	for(unsigned int i=0; i<ImageDimension; ++i)
+		for(unsigned int j=0; j<ImageDimension; ++j)
+			identity = identity && direction[i][j] == ( i == j ? 1 : 0 );
+
+	const InputPixelType *in = input->GetBufferPointer() + p * planePixels;
+	for(unsigned long i=0; i<planePixels; ++i, ++in)
+	{
+		CVector local;
+		for(unsigned int d=0; d<ImageDimension; ++d)
+		{
+			const long below = index[d] > 0 ? strides[d] : 0;
+			const long above = index[d] + 1 < static_cast< long >( size[d] ) ? strides[d] : 0;
+			local[d] = ( static_cast< float >( in[above] ) - static_cast< float >( in[-below] ) ) * scales[d];
+		}
+
+		// GradientImageFilter's gradients are along the physical axes
+		CVector gradient = local;
+		if( !identity )
+		{
+			for(unsigned int j=0; j<ImageDimension; ++j)
+			{
+				double sum = 0;
+				for(unsigned int k=0; k<ImageDimension; ++k) sum += direction[j][k] * local[k];
+				gradient[j] = sum;
+			}
+		}
+
+		TensorType& tensor = plane[i];
+		for(unsigned int j=0; j<ImageDimension; ++j)
+			for(unsigned int k=j; k<ImageDimension; ++k)
+				tensor(j,k) = gradient[j] * gradient[k];
+
+		for(unsigned int d=0; d<Last; ++d)
+		{
+			if( ++index[d] < static_cast< long >( size[d] ) ) break;
+			index[d] = 0;
+		}
+	}
+}
+
+template< class TInputImage >
+void StructureTensorImageFilter< TInputImage >
+::SmoothPlane(TensorType *plane, TensorType *scratch) const
+{
+	const typename RegionType::SizeType& size = this->GetInput()->GetBufferedRegion().GetSize();
+	unsigned long planePixels = 1;
+	for(unsigned int d=0; d<ImageDimension - 1; ++d) planePixels *= size[d];
+
+	unsigned long stride = 1;
+	for(unsigned int d=0; d<ImageDimension - 1; stride *= size[d], ++d)
+	{
+		const std::vector< float >& weights = m_Weights[d];
+		if( weights.size() == 1 ) continue;
+
+		// the plane is outer blocks of size[d] runs of inner floats, each run
+		// smoothed with its neighbours along d
+		const long r = weights.size() / 2, length = size[d];
+		const unsigned long inner = stride * Components, outer = planePixels / ( stride * length );
+		std::copy( plane, plane + planePixels, scratch );
+		const float *in = reinterpret_cast< const float * >( scratch );
+		float *out = reinterpret_cast< float * >( plane );
+
+		std::vector< const float * > lines( weights.size() );
+		for(unsigned long o=0; o<outer; ++o)
+		{
+			for(long i=0; i<length; ++i)
+			{
+				for(long t=0; t<2 * r + 1; ++t)
+				{
+					const long j = std::min( std::max( i - r + t, 0L ), length - 1 );
+					lines[t] = in + ( o * length + j ) * inner;
+				}
+				StructureTensorWeightedSum( &lines[0], weights, out + ( o * length + i ) * inner, inner );
+			}
+		}
+	}
+}
+
+template< class TInputImage >
+void StructureTensorImageFilter< TInputImage >
+::SmoothSlab(long first, long end)
+{
+	if( first >= end ) return;
+
+	const typename RegionType::SizeType& size = this->GetInput()->GetBufferedRegion().GetSize();
+	const unsigned int Last = ImageDimension - 1;
+	const long length = size[Last];
+	unsigned long planePixels = 1;
+	for(unsigned int d=0; d<Last; ++d) planePixels *= size[d];
+
+	// a ring of planes smoothed within themselves, keyed by plane
+	const std::vector< float >& weights = m_Weights[Last];
+	const long r = weights.size() / 2, taps = 2 * r + 1;
+	std::vector< TensorType > ring( taps * planePixels ), scratch( planePixels );
+	std::vector< long > ringPlanes( taps, std::numeric_limits< long >::min() );
+	std::vector< const float * > planes( taps );
+
+	TensorType *out = this->GetOutput()->GetBufferPointer() + first * planePixels;
+	for(long p=first; p<end; ++p, out+=planePixels)
+	{
+		for(long t=0; t<taps; ++t)
+		{
+			const long q = std::min( std::max( p - r + t, 0L ), length - 1 );
+			const long slot = q % taps;
+			TensorType *plane = &ring[slot * planePixels];
+			if( ringPlanes[slot] != q )
+			{
+				ComputeTensors( q, plane );
+				SmoothPlane( plane, &scratch[0] );
+				ringPlanes[slot] = q;
+			}
+			planes[t] = reinterpret_cast< const float * >( plane );
+		}
+
+		StructureTensorWeightedSum( &planes[0], weights, reinterpret_cast< float * >( out ), planePixels * Components );
+	}
+}
+
+template< class TInputImage >
+void StructureTensorImageFilter< TInputImage >
+::GenerateDataWithPipeline()
 {
 	typedef GradientImageFilter<TInputImage> GradientType;
 	//we use GradientImageFilter instead of GradientRecursiveGaussianImageFilter
@@ -37,4 +280,4 @@ void StructureTensorImageFilter< TInputImage >
 
 }// end namespace
 
-#endif //__itkStructureTensorImageFilter_txx
\ No newline at end of file
+#endif //__itkStructureTensorImageFilter_txx